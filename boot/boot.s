@@ -145,18 +145,17 @@ align 4096
 global pml4_table
 global pdpt_table
 global pd_table
-global pd_table_heap
 
 ; PML4 → PDPT
 pml4_table:
     dq pdpt_table + 0x03        ; Present | RW
+    times 511 dq 0              ; heap and recursive slots filled in by paging_init
 align 4096
 
 ; PDPT → PDs
 pdpt_table:
     dq pd_table + 0x03          ; First PD: low memory (kernel)
-    dq pd_table_heap + 0x03     ; Second PD: heap region
-    times 510 dq 0              ; rest unused
+    times 511 dq 0              ; rest unused
 align 4096
 
 ; PD #0 → first 4 MiB of memory
@@ -168,7 +167,3 @@ pd_table:
     %endrep
     times (512 - 2) dq 0       ; fill rest with zeros
 align 4096
-
-; PD #1 → heap region (empty, mapped dynamically)
-pd_table_heap:
-    times 512 dq 0
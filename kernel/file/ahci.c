@@ -0,0 +1,454 @@
+#include <stddef.h>
+#include "../memory/paging.h"
+#include "../pci/pci.h"
+#include "../string.h"
+#include "ahci.h"
+
+// HBA registers (32-bit indices into ABAR)
+#define HBA_CAP  0x00
+#define HBA_GHC  0x01
+#define HBA_PI   0x03
+#define HBA_CAP_S64A   (1U << 31)
+#define HBA_CAP_SNCQ   (1U << 30)
+#define HBA_GHC_AE     (1U << 31)
+#define HBA_PORTS_OFFSET 0x100
+#define HBA_PORT_SIZE    0x80
+
+// Port registers (32-bit indices into the port block)
+#define PX_CLB   0
+#define PX_CLBU  1
+#define PX_FB    2
+#define PX_FBU   3
+#define PX_IS    4
+#define PX_IE    5
+#define PX_CMD   6
+#define PX_TFD   8
+#define PX_SIG   9
+#define PX_SSTS  10
+#define PX_SERR  12
+#define PX_SACT  13
+#define PX_CI    14
+
+#define PX_CMD_ST   (1U << 0)
+#define PX_CMD_FRE  (1U << 4)
+#define PX_CMD_FR   (1U << 14)
+#define PX_CMD_CR   (1U << 15)
+#define PX_IS_TFES  (1U << 30)  // task file error
+#define PX_TFD_BSY  0x80
+#define PX_TFD_DRQ  0x08
+
+#define SATA_SIG_ATA 0x00000101
+#define FIS_TYPE_REG_H2D 0x27
+#define CMD_HEADER_WRITE (1 << 6)
+
+#define ATA_CMD_READ_DMA_EXT      0x25
+#define ATA_CMD_READ_FPDMA_QUEUED 0x60
+#define ATA_CMD_WRITE_DMA_EXT     0x35
+#define ATA_CMD_WRITE_FPDMA_QUEUED 0x61
+#define ATA_CMD_FLUSH_CACHE_EXT   0xEA
+#define ATA_CMD_IDENTIFY          0xEC
+
+#define AHCI_PRD_ENTRIES 56      // pads a command table to 1 KB
+#define AHCI_TIMEOUT     10000000
+#define SECTOR_BYTES     512
+
+typedef struct {
+    uint16_t flags;              // FIS length in dwords, W (bit 6)
+    uint16_t prdtl;              // PRD entries in the table
+    volatile uint32_t prdbc;     // bytes transferred
+    uint32_t ctba;
+    uint32_t ctbau;
+    uint32_t reserved[4];
+} __attribute__((packed)) AhciCommandHeader;
+
+typedef struct {
+    uint32_t dba;
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;                // byte count - 1, bit 31 = interrupt
+} __attribute__((packed)) AhciPrd;
+
+typedef struct {
+    uint8_t cfis[64];
+    uint8_t acmd[16];
+    uint8_t reserved[48];
+    AhciPrd prdt[AHCI_PRD_ENTRIES];
+} __attribute__((packed)) AhciCommandTable;
+
+static AhciDisk ahci_disks[AHCI_MAX_DISKS];
+static int ahci_count = 0;
+static int ahci_64bit = 0;       // HBA can address memory above 4 GB
+
+static int ahci_wait_clear(volatile uint32_t *reg, uint32_t bits) {
+    for (int i = 0; i < AHCI_TIMEOUT; i++) {
+        if (!(*reg & bits))
+            return 0;
+        __asm__ volatile("pause");
+    }
+    return -1;
+}
+
+// ==== Port engine ====
+static int ahci_port_stop(volatile uint32_t *regs) {
+    regs[PX_CMD] &= ~(PX_CMD_ST | PX_CMD_FRE);
+    return ahci_wait_clear(&regs[PX_CMD], PX_CMD_CR | PX_CMD_FR);
+}
+
+static int ahci_port_start(volatile uint32_t *regs) {
+    if (ahci_wait_clear(&regs[PX_TFD], PX_TFD_BSY | PX_TFD_DRQ) < 0)
+        return -1;
+    regs[PX_SERR] = 0xFFFFFFFF;
+    regs[PX_IS] = 0xFFFFFFFF;
+    regs[PX_CMD] |= PX_CMD_FRE;
+    regs[PX_CMD] |= PX_CMD_ST;
+    return 0;
+}
+
+static int ahci_addressable(uint64_t phys) {
+    return ahci_64bit || phys < (1ULL << 32);
+}
+
+// Command list (1 KB) and received-FIS area (256 B) share one page; the
+// 1 KB command tables go four to a page
+static int ahci_port_setup(AhciDisk *disk) {
+    uint64_t phys;
+    uint8_t *page = paging_alloc_dma(PAGE_SIZE_4K, &phys);
+    if (!page || !ahci_addressable(phys))
+        return -1;
+    disk->cmd_list = page;
+    disk->regs[PX_CLB] = (uint32_t)phys;
+    disk->regs[PX_CLBU] = (uint32_t)(phys >> 32);
+    disk->regs[PX_FB] = (uint32_t)(phys + 1024);
+    disk->regs[PX_FBU] = (uint32_t)((phys + 1024) >> 32);
+
+    AhciCommandHeader *headers = disk->cmd_list;
+    for (int slot = 0; slot < AHCI_MAX_SLOTS; slot += 4) {
+        uint8_t *tables = paging_alloc_dma(PAGE_SIZE_4K, &phys);
+        if (!tables || !ahci_addressable(phys))
+            return -1;
+        for (int i = 0; i < 4; i++) {
+            disk->tables[slot + i] = tables + i * sizeof(AhciCommandTable);
+            headers[slot + i].ctba = (uint32_t)(phys + i * sizeof(AhciCommandTable));
+            headers[slot + i].ctbau = (uint32_t)((phys + i * sizeof(AhciCommandTable)) >> 32);
+        }
+    }
+    return 0;
+}
+
+// ==== Commands ====
+// Describes the buffer page by page, merging physically contiguous pages.
+// Returns the entry count or -1.
+static int ahci_build_prdt(AhciPrd *prdt, uint8_t *buf, uint32_t bytes) {
+    if ((uintptr_t)buf & 1)
+        return -1;
+    int n = 0;
+    uint32_t run = 0;
+    while (bytes) {
+        uintptr_t virt = (uintptr_t)buf;
+        uint32_t len = PAGE_SIZE_4K - (virt & (PAGE_SIZE_4K - 1));
+        if (len > bytes)
+            len = bytes;
+        (void)*(volatile uint8_t *)buf;  // commit a demand-paged heap page first
+        uint64_t phys = paging_virt_to_phys(virt);
+        if (!phys || !ahci_addressable(phys))
+            return -1;
+        uint64_t prev = n ? ((uint64_t)prdt[n - 1].dbau << 32 | prdt[n - 1].dba) : 0;
+        if (n && prev + run == phys) {
+            run += len;
+        } else {
+            if (n == AHCI_PRD_ENTRIES)
+                return -1;
+            prdt[n].dba = (uint32_t)phys;
+            prdt[n].dbau = (uint32_t)(phys >> 32);
+            prdt[n].reserved = 0;
+            n++;
+            run = len;
+        }
+        prdt[n - 1].dbc = run - 1;
+        buf += len;
+        bytes -= len;
+    }
+    return n;
+}
+
+static int ahci_free_slot(AhciDisk *disk) {
+    for (int slot = 0; slot < disk->queue_depth; slot++)
+        if (!(disk->busy & (1U << slot)))
+            return slot;
+    return -1;
+}
+
+static int ahci_is_queued(uint8_t command) {
+    return command == ATA_CMD_READ_FPDMA_QUEUED || command == ATA_CMD_WRITE_FPDMA_QUEUED;
+}
+
+// Fills slot's command FIS and PRDT and hands it to the HBA
+static int ahci_issue(AhciDisk *disk, int slot, uint8_t command, uint64_t lba,
+                      uint32_t count, void *buffer, uint32_t bytes) {
+    AhciCommandTable *table = disk->tables[slot];
+    AhciCommandHeader *header = (AhciCommandHeader *)disk->cmd_list + slot;
+    int entries = ahci_build_prdt(table->prdt, buffer, bytes);
+    if (entries < 0)
+        return -1;
+
+    uint8_t *fis = table->cfis;
+    for (int i = 0; i < 20; i++)
+        fis[i] = 0;
+    fis[0] = FIS_TYPE_REG_H2D;
+    fis[1] = 0x80;                 // command, not control
+    fis[2] = command;
+    fis[4] = (uint8_t)lba;
+    fis[5] = (uint8_t)(lba >> 8);
+    fis[6] = (uint8_t)(lba >> 16);
+    fis[7] = (command == ATA_CMD_IDENTIFY || command == ATA_CMD_FLUSH_CACHE_EXT) ? 0 : 0x40;  // LBA mode
+    fis[8] = (uint8_t)(lba >> 24);
+    fis[9] = (uint8_t)(lba >> 32);
+    fis[10] = (uint8_t)(lba >> 40);
+    if (ahci_is_queued(command)) {
+        fis[3] = (uint8_t)count;   // NCQ moves the count into FEATURES
+        fis[11] = (uint8_t)(count >> 8);
+        fis[12] = (uint8_t)(slot << 3);
+    } else {
+        fis[12] = (uint8_t)count;
+        fis[13] = (uint8_t)(count >> 8);
+    }
+
+    int write = command == ATA_CMD_WRITE_DMA_EXT || command == ATA_CMD_WRITE_FPDMA_QUEUED;
+    header->flags = 5 | (write ? CMD_HEADER_WRITE : 0);  // 20-byte H2D FIS
+    header->prdtl = (uint16_t)entries;
+    header->prdbc = 0;
+    __asm__ volatile("" : : : "memory");  // descriptors are written before the doorbell
+
+    disk->busy |= 1U << slot;
+    disk->failed &= ~(1U << slot);
+    if (ahci_is_queued(command))
+        disk->regs[PX_SACT] = 1U << slot;
+    disk->regs[PX_CI] = 1U << slot;
+    return 0;
+}
+
+// Retires finished slots. A task-file error halts the port, so every
+// command still in flight is failed and the engine restarted.
+static void ahci_reap(AhciDisk *disk) {
+    volatile uint32_t *regs = disk->regs;
+    if (regs[PX_IS] & PX_IS_TFES) {
+        disk->failed |= disk->busy;
+        disk->busy = 0;
+        ahci_port_stop(regs);
+        ahci_port_start(regs);
+        return;
+    }
+    uint32_t pending = regs[PX_CI] | regs[PX_SACT];
+    disk->busy &= pending;
+}
+
+int ahci_wait(AhciDisk *disk, uint32_t tags) {
+    for (int i = 0; i < AHCI_TIMEOUT && (disk->busy & tags); i++) {
+        ahci_reap(disk);
+        __asm__ volatile("pause");
+    }
+    if (disk->busy & tags) {
+        // The device stopped answering: start over with an empty queue
+        disk->failed |= disk->busy;
+        disk->busy = 0;
+        ahci_port_stop(disk->regs);
+        ahci_port_start(disk->regs);
+    }
+    int result = (disk->failed & tags) ? -1 : 0;
+    disk->failed &= ~tags;
+    return result;
+}
+
+static int ahci_queue(AhciDisk *disk, uint64_t lba, uint32_t count, void *buffer, int write) {
+    if (!disk || !count || count > AHCI_MAX_SECTORS || lba + count > disk->sectors)
+        return -1;
+    ahci_reap(disk);
+    int slot = ahci_free_slot(disk);
+    if (slot < 0)
+        return -1;
+    uint8_t command = write ? (disk->ncq ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_WRITE_DMA_EXT)
+                            : (disk->ncq ? ATA_CMD_READ_FPDMA_QUEUED : ATA_CMD_READ_DMA_EXT);
+    if (ahci_issue(disk, slot, command, lba, count, buffer, count * SECTOR_BYTES) < 0)
+        return -1;
+    return slot;
+}
+
+int ahci_submit(AhciDisk *disk, uint64_t lba, uint32_t count, void *buffer) {
+    return ahci_queue(disk, lba, count, buffer, 0);
+}
+
+// Splits a transfer into commands, keeping up to queue_depth in flight
+static int ahci_transfer(AhciDisk *disk, uint64_t lba, uint32_t count, uint8_t *buf, int write) {
+    uint32_t tags = 0;
+    int result = 0;
+    while (count) {
+        uint32_t n = count < AHCI_MAX_SECTORS ? count : AHCI_MAX_SECTORS;
+        int tag = ahci_queue(disk, lba, n, buf, write);
+        if (tag < 0) {
+            if (!tags)
+                return -1;  // nothing in flight, so the request itself is bad
+            result |= ahci_wait(disk, tags);
+            tags = 0;
+            continue;
+        }
+        tags |= 1U << tag;
+        lba += n;
+        buf += n * SECTOR_BYTES;
+        count -= n;
+    }
+    result |= ahci_wait(disk, tags);
+    return result ? -1 : 0;
+}
+
+int ahci_read(AhciDisk *disk, uint64_t lba, uint32_t count, void *buffer) {
+    return ahci_transfer(disk, lba, count, buffer, 0);
+}
+
+// The HBA only reads the buffer of a write command, so the cast is safe
+int ahci_write(AhciDisk *disk, uint64_t lba, uint32_t count, const void *buffer) {
+    return ahci_transfer(disk, lba, count, (uint8_t *)buffer, 1);
+}
+
+// FLUSH CACHE is not queued, so it waits for everything in flight first
+int ahci_flush(AhciDisk *disk) {
+    if (!disk)
+        return -1;
+    ahci_wait(disk, disk->busy);
+    if (ahci_issue(disk, 0, ATA_CMD_FLUSH_CACHE_EXT, 0, 0, NULL, 0) < 0)
+        return -1;
+    return ahci_wait(disk, 1);
+}
+
+// ==== Discovery ====
+static void ahci_copy_string(char *out, const uint16_t *words, int count) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        out[n++] = (char)(words[i] >> 8);
+        out[n++] = (char)(words[i] & 0xFF);
+    }
+    while (n > 0 && out[n - 1] == ' ')
+        n--;
+    out[n] = 0;
+}
+
+static int ahci_identify(AhciDisk *disk, uint32_t hba_slots, int hba_ncq) {
+    static uint16_t id[256] __attribute__((aligned(512)));
+    disk->queue_depth = 1;
+    if (ahci_issue(disk, 0, ATA_CMD_IDENTIFY, 0, 0, id, sizeof(id)) < 0)
+        return -1;
+    if (ahci_wait(disk, 1) < 0)
+        return -1;
+    disk->sectors = ((uint64_t)id[103] << 48) | ((uint64_t)id[102] << 32)
+                  | ((uint64_t)id[101] << 16) | id[100];
+    if (!disk->sectors)
+        disk->sectors = ((uint32_t)id[61] << 16) | id[60];
+    disk->ncq = hba_ncq && (id[76] & (1 << 8));
+    if (disk->ncq) {
+        uint32_t depth = (id[75] & 0x1F) + 1;
+        disk->queue_depth = depth < hba_slots ? depth : hba_slots;
+    } else {
+        disk->queue_depth = hba_slots;  // plain commands still queue in the HBA
+    }
+    ahci_copy_string(disk->model, &id[27], 20);
+    return 0;
+}
+
+static int ahci_block_read(BlockDevice *block, uint64_t lba, uint32_t count, void *buffer) {
+    return ahci_read(block->driver, lba, count, buffer);
+}
+
+static int ahci_block_write(BlockDevice *block, uint64_t lba, uint32_t count, const void *buffer) {
+    return ahci_write(block->driver, lba, count, buffer);
+}
+
+static int ahci_block_flush(BlockDevice *block) {
+    return ahci_flush(block->driver);
+}
+
+static int ahci_block_submit(BlockDevice *block, uint64_t lba, uint32_t count, void *buffer) {
+    return ahci_submit(block->driver, lba, count, buffer);
+}
+
+static int ahci_block_wait(BlockDevice *block, uint32_t tags) {
+    return ahci_wait(block->driver, tags);
+}
+
+static const BlockDeviceOps ahci_block_ops = {
+    .read = ahci_block_read,
+    .write = ahci_block_write,
+    .submit = ahci_block_submit,
+    .wait = ahci_block_wait,
+    .flush = ahci_block_flush,
+};
+
+static void ahci_register(AhciDisk *disk, int index) {
+    BlockDevice *block = &disk->block;
+    str_copy(block->name, "sata0", BLOCK_NAME_LEN);
+    block->name[4] += index;
+    block->ops = &ahci_block_ops;
+    block->driver = disk;
+    block->block_size = 512;
+    block->blocks = disk->sectors;
+    block->max_request = AHCI_MAX_SECTORS;
+    block->kind = disk->ncq ? "AHCI NCQ" : "AHCI";
+    block->model = disk->model;
+    block_register(block);
+}
+
+int ahci_init(void) {
+    ahci_count = 0;
+    const PciDevice *pci = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, 0);
+    if (!pci || pci->prog_if != 0x01)
+        return 0;
+    int is_io;
+    uint64_t abar = pci_bar(pci, 5, &is_io);
+    if (!abar || is_io)
+        return 0;
+    // Completion is polled, so keep the controller off the shared INTx line
+    pci_enable(pci, PCI_COMMAND_MEMORY | PCI_COMMAND_BUS_MASTER | PCI_COMMAND_INTX_OFF);
+    volatile uint32_t *hba = paging_map_mmio(abar, HBA_PORTS_OFFSET + AHCI_MAX_SLOTS * HBA_PORT_SIZE);
+    if (!hba)
+        return 0;
+
+    hba[HBA_GHC] |= HBA_GHC_AE;
+    uint32_t cap = hba[HBA_CAP];
+    uint32_t slots = ((cap >> 8) & 0x1F) + 1;
+    ahci_64bit = (cap & HBA_CAP_S64A) != 0;
+    uint32_t implemented = hba[HBA_PI];
+
+    for (int port = 0; port < 32 && ahci_count < AHCI_MAX_DISKS; port++) {
+        if (!(implemented & (1U << port)))
+            continue;
+        volatile uint32_t *regs = hba + (HBA_PORTS_OFFSET + port * HBA_PORT_SIZE) / 4;
+        uint32_t ssts = regs[PX_SSTS];
+        if ((ssts & 0x0F) != 3 || ((ssts >> 8) & 0x0F) != 1)
+            continue;  // no device, or link not active
+        if (regs[PX_SIG] != SATA_SIG_ATA)
+            continue;  // ATAPI, port multiplier, ...
+
+        AhciDisk *disk = &ahci_disks[ahci_count];
+        disk->present = 0;
+        disk->port = port;
+        disk->regs = regs;
+        disk->busy = disk->failed = 0;
+        regs[PX_IE] = 0;
+        if (ahci_port_stop(regs) < 0 || ahci_port_setup(disk) < 0 || ahci_port_start(regs) < 0)
+            continue;
+        if (ahci_identify(disk, slots, (cap & HBA_CAP_SNCQ) != 0) < 0)
+            continue;
+        disk->present = 1;
+        ahci_register(disk, ahci_count);
+        ahci_count++;
+    }
+    return ahci_count;
+}
+
+int ahci_disk_count(void) {
+    return ahci_count;
+}
+
+AhciDisk* ahci_get_disk(int index) {
+    if (index < 0 || index >= ahci_count)
+        return NULL;
+    return &ahci_disks[index];
+}
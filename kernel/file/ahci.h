@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include "block.h"
+
+#define AHCI_MAX_DISKS   4
+#define AHCI_MAX_SLOTS   32   // command slots per port, also the NCQ tag space
+#define AHCI_MAX_SECTORS 256  // per command; ahci_read splits larger requests
+
+typedef struct {
+    uint8_t  present;
+    uint8_t  port;
+    uint8_t  ncq;              // transfers use READ/WRITE FPDMA QUEUED
+    uint8_t  queue_depth;      // commands that may be outstanding at once
+    uint64_t sectors;          // capacity in 512-byte sectors
+    char     model[41];
+    volatile uint32_t *regs;   // port register block
+    void     *cmd_list;        // AHCI_MAX_SLOTS command headers
+    void     *tables[AHCI_MAX_SLOTS];
+    uint32_t busy;             // slots with a command in flight
+    uint32_t failed;           // finished slots whose command failed
+    BlockDevice block;         // registered as sata0, sata1, ...
+} AhciDisk;
+
+// Finds the AHCI controller on PCI (call pci_init first) and brings up every
+// port with a SATA disk attached, registering each as a block device.
+// Returns the number of disks.
+int ahci_init(void);
+
+int ahci_disk_count(void);
+AhciDisk* ahci_get_disk(int index);
+
+// Queues a read of at most AHCI_MAX_SECTORS without waiting for it.
+// Returns the command's tag, or -1 if every slot is taken or the buffer
+// cannot be described to the HBA (odd address, too fragmented).
+int ahci_submit(AhciDisk *disk, uint64_t lba, uint32_t count, void *buffer);
+
+// Waits for every tag set in `tags`. Returns 0, or -1 if any of them failed.
+int ahci_wait(AhciDisk *disk, uint32_t tags);
+
+// Reads `count` sectors, keeping up to queue_depth commands in flight.
+// Returns 0 on success, -1 on failure.
+int ahci_read(AhciDisk *disk, uint64_t lba, uint32_t count, void *buffer);
+
+// Writes `count` sectors the same way. Returns 0 on success, -1 on failure.
+int ahci_write(AhciDisk *disk, uint64_t lba, uint32_t count, const void *buffer);
+
+// Waits for outstanding commands, then commits the drive's write cache.
+// Returns 0 on success, -1 on failure.
+int ahci_flush(AhciDisk *disk);
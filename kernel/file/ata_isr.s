@@ -0,0 +1,43 @@
+[BITS 64]
+global ata_primary_isr
+global ata_secondary_isr
+extern ata_irq_handler_c
+
+; IRQ14 (primary channel) and IRQ15 (secondary channel), both behind the slave PIC
+ata_primary_isr:
+    push rdi
+    mov rdi, 0
+    jmp ata_isr_common
+
+ata_secondary_isr:
+    push rdi
+    mov rdi, 1
+
+ata_isr_common:
+    push rax
+    push rcx
+    push rdx
+    push rsi
+    push r8
+    push r9
+    push r10
+    push r11                  ; 9 pushes on the 40-byte frame: stack is 16-byte aligned
+
+    call ata_irq_handler_c    ; channel index in RDI
+
+    ; === Send End-of-Interrupt to both PICs ===
+    mov al, 0x20
+    out 0xA0, al
+    out 0x20, al
+
+    ; === Restore registers ===
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rsi
+    pop rdx
+    pop rcx
+    pop rax
+    pop rdi
+    iretq
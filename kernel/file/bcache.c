@@ -0,0 +1,276 @@
+#include "../memory/memory.h"
+#include "../string.h"
+#include "bcache.h"
+
+typedef struct BCacheEntry {
+    BlockDevice *dev;
+    uint64_t lba;
+    struct BCacheEntry *hash_next;  // bucket chain
+    struct BCacheEntry *newer;      // LRU list, most recent at lru_head
+    struct BCacheEntry *older;
+    uint8_t dirty;                  // newer than the device
+    uint8_t *data;
+} BCacheEntry;
+
+static BCacheEntry *buckets[BCACHE_HASH_SIZE];
+static BCacheEntry *lru_head = NULL;
+static BCacheEntry *lru_tail = NULL;
+static BCacheStats stats = { .limit = BCACHE_DEFAULT_LIMIT };
+static int reclaimer_added = 0;
+static uint64_t dirty_bytes = 0;
+static int writing_back = 0;
+static int write_failed = 0;  // a writeback failed since the last bcache_sync
+
+static inline uint32_t bcache_bucket(BlockDevice *dev, uint64_t lba) {
+    uint64_t key = lba ^ ((uint64_t)(uintptr_t)dev >> 4);
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 52) & (BCACHE_HASH_SIZE - 1);
+}
+
+static BCacheEntry* bcache_lookup(BlockDevice *dev, uint64_t lba) {
+    for (BCacheEntry *e = buckets[bcache_bucket(dev, lba)]; e; e = e->hash_next)
+        if (e->lba == lba && e->dev == dev)
+            return e;
+    return NULL;
+}
+
+static void lru_unlink(BCacheEntry *e) {
+    if (e->newer) e->newer->older = e->older;
+    else lru_head = e->older;
+    if (e->older) e->older->newer = e->newer;
+    else lru_tail = e->newer;
+}
+
+static void lru_push(BCacheEntry *e) {
+    e->newer = NULL;
+    e->older = lru_head;
+    if (lru_head) lru_head->newer = e;
+    else lru_tail = e;
+    lru_head = e;
+}
+
+// Writes back the run of contiguous dirty blocks around `e` with a single
+// request, or block by block when no bounce buffer can be had
+static int bcache_writeback(BCacheEntry *e) {
+    BlockDevice *dev = e->dev;
+    uint32_t bs = dev->block_size;
+    uint32_t max = dev->max_request ? dev->max_request : 1;
+    uint64_t first = e->lba;
+    BCacheEntry *p;
+    while (first > 0 && e->lba - first + 1 < max && (p = bcache_lookup(dev, first - 1)) && p->dirty)
+        first--;
+    uint32_t run = (uint32_t)(e->lba - first + 1);
+    while (run < max && (p = bcache_lookup(dev, first + run)) && p->dirty)
+        run++;
+
+    writing_back = 1;  // the bounce buffer must not make the reclaimer evict the run
+    uint8_t *buf = run > 1 ? malloc((size_t)run * bs) : NULL;
+    writing_back = 0;
+    if (!buf) {
+        first = e->lba;
+        run = 1;
+    }
+    int result;
+    if (buf) {
+        for (uint32_t i = 0; i < run; i++)
+            memcpy(buf + (size_t)i * bs, bcache_lookup(dev, first + i)->data, bs);
+        result = block_write(dev, first, run, buf);
+        free(buf);
+    } else {
+        result = block_write(dev, first, 1, e->data);
+    }
+    if (result != 0) {
+        write_failed = 1;
+        return -1;
+    }
+    for (uint32_t i = 0; i < run; i++) {
+        p = bcache_lookup(dev, first + i);
+        p->dirty = 0;
+        dirty_bytes -= bs;
+        stats.dirty--;
+    }
+    stats.writebacks += run;
+    stats.flushes++;
+    return 0;
+}
+
+// Eviction only removes clean entries; a dirty one is dropped here only by
+// bcache_invalidate, after its writeback failed
+static void bcache_remove(BCacheEntry *e) {
+    if (e->dirty) {
+        dirty_bytes -= e->dev->block_size;
+        stats.dirty--;
+    }
+    BCacheEntry **link = &buckets[bcache_bucket(e->dev, e->lba)];
+    while (*link != e)
+        link = &(*link)->hash_next;
+    *link = e->hash_next;
+    lru_unlink(e);
+    stats.blocks--;
+    stats.bytes -= e->dev->block_size;
+    free(e->data);
+    free(e);
+}
+
+// Evicts from the cold end until `bytes` more would fit under the limit.
+// Dirty blocks that cannot be written back stay and are passed over.
+static void bcache_make_room(uint64_t bytes) {
+    BCacheEntry *e = lru_tail;
+    while (e && stats.bytes + bytes > stats.limit) {
+        BCacheEntry *newer = e->newer;
+        if (!e->dirty || bcache_writeback(e) == 0) {
+            bcache_remove(e);
+            stats.evictions++;
+        }
+        e = newer;
+    }
+}
+
+static BCacheEntry* bcache_insert(BlockDevice *dev, uint64_t lba, const uint8_t *src) {
+    if (dev->block_size > stats.limit)
+        return NULL;
+    bcache_make_room(dev->block_size);
+    if (stats.bytes + dev->block_size > stats.limit)
+        return NULL;  // full of blocks that cannot be written back
+    BCacheEntry *e = malloc(sizeof(BCacheEntry));
+    uint8_t *data = e ? malloc(dev->block_size) : NULL;
+    if (!data) {
+        free(e);  // under pressure, just don't cache
+        return NULL;
+    }
+    memcpy(data, src, dev->block_size);
+    e->dev = dev;
+    e->lba = lba;
+    e->dirty = 0;
+    e->data = data;
+    uint32_t b = bcache_bucket(dev, lba);
+    e->hash_next = buckets[b];
+    buckets[b] = e;
+    lru_push(e);
+    stats.blocks++;
+    stats.bytes += dev->block_size;
+    return e;
+}
+
+int bcache_read(BlockDevice *dev, uint64_t lba, uint32_t count, void *buffer) {
+    if (!dev || !stats.limit)
+        return block_read(dev, lba, count, buffer);
+    if (!reclaimer_added)
+        reclaimer_added = memory_add_reclaimer(bcache_shrink) == 0;
+
+    uint8_t *buf = buffer;
+    uint32_t i = 0;
+    while (i < count) {
+        BCacheEntry *e = bcache_lookup(dev, lba + i);
+        if (e) {
+            memcpy(buf + (size_t)i * dev->block_size, e->data, dev->block_size);
+            lru_unlink(e);
+            lru_push(e);
+            stats.hits++;
+            i++;
+            continue;
+        }
+        // Gather the run of misses and fetch it in one request
+        uint32_t run = 1;
+        while (i + run < count && run < dev->max_request && !bcache_lookup(dev, lba + i + run))
+            run++;
+        uint8_t *dst = buf + (size_t)i * dev->block_size;
+        if (block_read(dev, lba + i, run, dst) != 0)
+            return -1;
+        stats.misses += run;
+        for (uint32_t k = 0; k < run; k++)
+            bcache_insert(dev, lba + i + k, dst + (size_t)k * dev->block_size);
+        i += run;
+    }
+    return 0;
+}
+
+int bcache_write(BlockDevice *dev, uint64_t lba, uint32_t count, const void *buffer) {
+    if (!dev || !dev->ops->write)
+        return -1;
+    if (!stats.limit)
+        return block_write(dev, lba, count, buffer);
+    if (!reclaimer_added)
+        reclaimer_added = memory_add_reclaimer(bcache_shrink) == 0;
+
+    const uint8_t *src = buffer;
+    for (uint32_t i = 0; i < count; i++, src += dev->block_size) {
+        BCacheEntry *e = bcache_lookup(dev, lba + i);
+        if (e) {
+            memcpy(e->data, src, dev->block_size);
+            lru_unlink(e);
+            lru_push(e);
+        } else if (!(e = bcache_insert(dev, lba + i, src))) {
+            if (block_write(dev, lba + i, 1, src) != 0)
+                return -1;
+            continue;
+        }
+        if (!e->dirty) {
+            e->dirty = 1;
+            dirty_bytes += dev->block_size;
+            stats.dirty++;
+        }
+    }
+    if (dirty_bytes > BCACHE_DIRTY_LIMIT)
+        return bcache_sync(dev);
+    return 0;
+}
+
+int bcache_sync(BlockDevice *dev) {
+    int result = write_failed ? -1 : 0;
+    for (BCacheEntry *e = lru_tail; e && stats.dirty; e = e->newer)
+        if (e->dirty && (!dev || e->dev == dev) && bcache_writeback(e) != 0)
+            result = -1;
+    write_failed = 0;
+    return result;
+}
+
+void bcache_overlay(BlockDevice *dev, uint64_t lba, uint32_t count, void *buffer) {
+    if (!stats.dirty || !dev)
+        return;
+    uint8_t *buf = buffer;
+    for (uint32_t i = 0; i < count; i++) {
+        BCacheEntry *e = bcache_lookup(dev, lba + i);
+        if (e && e->dirty)
+            memcpy(buf + (size_t)i * dev->block_size, e->data, dev->block_size);
+    }
+}
+
+void bcache_invalidate(BlockDevice *dev) {
+    bcache_sync(dev);
+    BCacheEntry *e = lru_head;
+    while (e) {
+        BCacheEntry *older = e->older;
+        if (!dev || e->dev == dev)
+            bcache_remove(e);
+        e = older;
+    }
+}
+
+int bcache_set_limit(uint64_t bytes) {
+    if (!bytes && (bcache_sync(NULL) != 0 || stats.dirty))
+        return -1;
+    stats.limit = bytes;
+    bcache_make_room(0);
+    return 0;
+}
+
+size_t bcache_shrink(size_t bytes) {
+    size_t freed = 0;
+    if (writing_back)
+        return 0;
+    BCacheEntry *e = lru_tail;
+    while (e && freed < bytes) {
+        BCacheEntry *newer = e->newer;
+        if (!e->dirty || bcache_writeback(e) == 0) {
+            freed += e->dev->block_size + sizeof(BCacheEntry);
+            bcache_remove(e);
+            stats.evictions++;
+        }
+        e = newer;
+    }
+    return freed;
+}
+
+void bcache_get_stats(BCacheStats *out) {
+    *out = stats;
+}
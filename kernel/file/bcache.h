@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "block.h"
+
+// Buffer cache: single blocks keyed by (device, LBA) in a hash table, evicted
+// in LRU order once the cached data reaches a byte limit. The file system
+// reads directories through it; bulk file data bypasses it on reads.
+// Writes are write-back: blocks stay dirty in memory until a sync, eviction
+// or the dirty limit, and then contiguous dirty blocks go out as one request.
+#define BCACHE_HASH_SIZE     4096           // buckets, power of two
+#define BCACHE_DEFAULT_LIMIT (1024 * 1024)  // bytes of cached block data
+#define BCACHE_DIRTY_LIMIT   (256 * 1024)   // dirty bytes that trigger a sync
+
+typedef struct {
+    uint64_t hits;       // blocks served from memory
+    uint64_t misses;     // blocks read from the device
+    uint64_t evictions;  // blocks dropped for the limit or memory pressure
+    uint64_t blocks;     // blocks cached now
+    uint64_t bytes;      // block data cached now
+    uint64_t limit;
+    uint64_t dirty;      // blocks waiting to be written back
+    uint64_t writebacks; // blocks written back
+    uint64_t flushes;    // device requests those took
+} BCacheStats;
+
+// Reads `count` blocks, copying hits from memory and fetching each run of
+// misses with one device request. Returns 0, or -1 if the device failed.
+int bcache_read(BlockDevice *dev, uint64_t lba, uint32_t count, void *buffer);
+
+// Stores `count` blocks and marks them dirty; blocks that cannot be cached
+// are written through. Returns 0, or -1 if the device failed.
+int bcache_write(BlockDevice *dev, uint64_t lba, uint32_t count, const void *buffer);
+
+// Writes back every dirty block of `dev` (every device when NULL), one
+// request per contiguous run. Returns 0, or -1 if any write failed, here or
+// in an eviction since the last sync. Blocks that failed stay dirty.
+int bcache_sync(BlockDevice *dev);
+
+// Copies dirty cached blocks over `buffer`, which holds `count` blocks just
+// read from the device around the cache; a no-op while nothing is dirty
+void bcache_overlay(BlockDevice *dev, uint64_t lba, uint32_t count, void *buffer);
+
+// Writes back, then drops every cached block of `dev` (every device when NULL)
+void bcache_invalidate(BlockDevice *dev);
+
+// Changes the byte limit, evicting down to it; 0 disables caching. Returns
+// -1, keeping the old limit, for 0 while dirty blocks cannot be written back:
+// the uncached paths would not see them.
+int bcache_set_limit(uint64_t bytes);
+
+// Evicts least recently used blocks (writing back dirty ones, and keeping
+// those that fail) until about `bytes` are freed. Returns the bytes released.
+size_t bcache_shrink(size_t bytes);
+
+void bcache_get_stats(BCacheStats *out);
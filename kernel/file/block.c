@@ -0,0 +1,74 @@
+#include <stddef.h>
+#include "../string.h"
+#include "block.h"
+
+static BlockDevice *block_devices[BLOCK_MAX_DEVICES];
+static int block_device_count = 0;
+
+int block_register(BlockDevice *dev) {
+    if (!dev || !dev->ops || !dev->ops->read || block_device_count >= BLOCK_MAX_DEVICES)
+        return -1;
+    dev->reads = dev->blocks_read = 0;
+    dev->writes = dev->blocks_written = 0;
+    block_devices[block_device_count] = dev;
+    return block_device_count++;
+}
+
+int block_count(void) {
+    return block_device_count;
+}
+
+BlockDevice* block_get(int index) {
+    if (index < 0 || index >= block_device_count)
+        return NULL;
+    return block_devices[index];
+}
+
+BlockDevice* block_find(const char *name) {
+    for (int i = 0; i < block_device_count; i++)
+        if (!strcmp(block_devices[i]->name, name))
+            return block_devices[i];
+    return NULL;
+}
+
+static int block_in_range(BlockDevice *dev, uint64_t lba, uint32_t count) {
+    return dev && count && lba < dev->blocks && count <= dev->blocks - lba;
+}
+
+int block_read(BlockDevice *dev, uint64_t lba, uint32_t count, void *buffer) {
+    if (!block_in_range(dev, lba, count))
+        return -1;
+    dev->reads++;
+    dev->blocks_read += count;
+    return dev->ops->read(dev, lba, count, buffer);
+}
+
+int block_write(BlockDevice *dev, uint64_t lba, uint32_t count, const void *buffer) {
+    if (!block_in_range(dev, lba, count) || !dev->ops->write)
+        return -1;
+    dev->writes++;
+    dev->blocks_written += count;
+    return dev->ops->write(dev, lba, count, buffer);
+}
+
+int block_submit(BlockDevice *dev, uint64_t lba, uint32_t count, void *buffer) {
+    if (!block_in_range(dev, lba, count))
+        return -1;
+    if (!dev->ops->submit)
+        return block_read(dev, lba, count, buffer) ? -1 : 0;
+    dev->reads++;
+    dev->blocks_read += count;
+    return dev->ops->submit(dev, lba, count, buffer);
+}
+
+int block_wait(BlockDevice *dev, uint32_t tags) {
+    if (!dev || !dev->ops->wait || !tags)
+        return 0;
+    return dev->ops->wait(dev, tags);
+}
+
+int block_flush(BlockDevice *dev) {
+    if (!dev || !dev->ops->flush)
+        return 0;
+    return dev->ops->flush(dev);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+
+#define BLOCK_MAX_DEVICES 8
+#define BLOCK_NAME_LEN    8
+
+typedef struct BlockDevice BlockDevice;
+
+// Driver entry points. read is mandatory; the others may be NULL:
+// no write means read-only, no submit/wait means every request completes
+// before returning, no flush means the driver keeps nothing to write back.
+typedef struct {
+    int (*read)(BlockDevice *dev, uint64_t lba, uint32_t count, void *buffer);
+    int (*write)(BlockDevice *dev, uint64_t lba, uint32_t count, const void *buffer);
+    int (*submit)(BlockDevice *dev, uint64_t lba, uint32_t count, void *buffer);
+    int (*wait)(BlockDevice *dev, uint32_t tags);
+    int (*flush)(BlockDevice *dev);
+} BlockDeviceOps;
+
+struct BlockDevice {
+    char     name[BLOCK_NAME_LEN];  // ata0, sata0, vda, ram0, ...
+    const BlockDeviceOps *ops;
+    void     *driver;               // the driver's own device record
+    uint32_t block_size;            // bytes per block
+    uint64_t blocks;                // capacity in blocks
+    uint32_t max_request;           // blocks per request before a driver splits it
+    const char *kind;               // driver and transfer mode, for listings
+    const char *model;              // NULL if the device has no name
+    uint64_t reads;                 // requests served
+    uint64_t blocks_read;
+    uint64_t writes;
+    uint64_t blocks_written;
+};
+
+// Drivers call this for every device they bring up; the device must stay
+// valid forever. Returns the device index or -1 if the table is full.
+int block_register(BlockDevice *dev);
+
+int block_count(void);
+BlockDevice* block_get(int index);
+BlockDevice* block_find(const char *name);
+
+// Synchronous transfers of `count` blocks. Return 0 on success, -1 on
+// failure, out-of-range requests or (for writes) read-only devices.
+int block_read(BlockDevice *dev, uint64_t lba, uint32_t count, void *buffer);
+int block_write(BlockDevice *dev, uint64_t lba, uint32_t count, const void *buffer);
+
+// Asynchronous reads: submit returns a tag (0..31), or -1 if the queue is
+// full (wait for earlier tags and retry) or the request is invalid.
+// Devices without a queue finish the read inside submit and return tag 0.
+int block_submit(BlockDevice *dev, uint64_t lba, uint32_t count, void *buffer);
+int block_wait(BlockDevice *dev, uint32_t tags);
+
+// Writes back anything the driver or device still caches
+int block_flush(BlockDevice *dev);
@@ -0,0 +1,102 @@
+#include "../string.h"
+#include "dentry.h"
+
+typedef struct {
+    uint32_t dir;        // 0 = free slot (cluster 0 is never a directory)
+    uint32_t last_used;
+    DentryInfo info;
+    char     name[DENTRY_NAME_LEN];
+} Dentry;
+
+static Dentry dentries[DENTRY_SETS][DENTRY_WAYS];
+static uint32_t dentry_clock = 0;
+static DentryStats stats;
+
+// Lowercases `name` into key; returns its FNV-1a hash, or 0 if it is too long
+static uint32_t dentry_key(const char *name, char key[DENTRY_NAME_LEN]) {
+    uint32_t hash = 2166136261u;
+    int i = 0;
+    for (; name[i]; i++) {
+        if (i == DENTRY_NAME_LEN - 1)
+            return 0;
+        key[i] = to_lower(name[i]);
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+    }
+    key[i] = 0;
+    return hash | 1;
+}
+
+static Dentry* dentry_set(uint32_t dir, uint32_t hash) {
+    return dentries[(hash ^ (dir * 2654435761u)) & (DENTRY_SETS - 1)];
+}
+
+static Dentry* dentry_find(Dentry *set, uint32_t dir, const char *key) {
+    for (int w = 0; w < DENTRY_WAYS; w++)
+        if (set[w].dir == dir && !strcmp(set[w].name, key))
+            return &set[w];
+    return NULL;
+}
+
+int dentry_lookup(uint32_t dir, const char *name, DentryInfo *out) {
+    char key[DENTRY_NAME_LEN];
+    uint32_t hash = dentry_key(name, key);
+    Dentry *d = hash ? dentry_find(dentry_set(dir, hash), dir, key) : NULL;
+    if (!d) {
+        stats.misses++;
+        return 0;
+    }
+    d->last_used = ++dentry_clock;
+    *out = d->info;
+    if (d->info.negative)
+        stats.negative_hits++;
+    else
+        stats.hits++;
+    return 1;
+}
+
+void dentry_insert(uint32_t dir, const char *name, const DentryInfo *info) {
+    char key[DENTRY_NAME_LEN];
+    uint32_t hash = dentry_key(name, key);
+    if (!hash || !dir)
+        return;
+    Dentry *set = dentry_set(dir, hash);
+    Dentry *d = dentry_find(set, dir, key);
+    for (int w = 0; w < DENTRY_WAYS && !d; w++)
+        if (!set[w].dir)
+            d = &set[w];
+    if (!d) {
+        d = &set[0];
+        for (int w = 1; w < DENTRY_WAYS; w++)
+            if (set[w].last_used < d->last_used)
+                d = &set[w];
+    }
+    d->dir = dir;
+    d->last_used = ++dentry_clock;
+    d->info = *info;
+    str_copy(d->name, key, DENTRY_NAME_LEN);
+}
+
+void dentry_invalidate(uint32_t dir, const char *name) {
+    char key[DENTRY_NAME_LEN];
+    uint32_t hash = dentry_key(name, key);
+    Dentry *d = hash ? dentry_find(dentry_set(dir, hash), dir, key) : NULL;
+    if (d)
+        d->dir = 0;
+}
+
+void dentry_invalidate_dir(uint32_t dir) {
+    for (int s = 0; s < DENTRY_SETS; s++)
+        for (int w = 0; w < DENTRY_WAYS; w++)
+            if (dentries[s][w].dir == dir)
+                dentries[s][w].dir = 0;
+}
+
+void dentry_flush(void) {
+    for (int s = 0; s < DENTRY_SETS; s++)
+        for (int w = 0; w < DENTRY_WAYS; w++)
+            dentries[s][w].dir = 0;
+}
+
+void dentry_get_stats(DentryStats *out) {
+    *out = stats;
+}
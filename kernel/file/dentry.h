@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+
+// Directory entry cache: (directory cluster, lowercase name) -> what the
+// name resolves to, including names known not to exist. Bounded to
+// DENTRY_SETS x DENTRY_WAYS slots; the least recently used way of a set is
+// replaced. Names of DENTRY_NAME_LEN or more characters are never cached.
+#define DENTRY_SETS     64    // power of two
+#define DENTRY_WAYS     4
+#define DENTRY_NAME_LEN 64
+
+typedef struct {
+    uint8_t  negative;  // the name does not exist in the directory
+    uint8_t  is_dir;
+    uint32_t cluster;   // first cluster of the file or directory
+    uint32_t size;      // file size in bytes (0 for directories)
+    uint32_t slot;      // position of the entry in its directory
+} DentryInfo;
+
+// Returns 1 and fills *out on a hit (check out->negative), 0 on a miss
+int dentry_lookup(uint32_t dir, const char *name, DentryInfo *out);
+void dentry_insert(uint32_t dir, const char *name, const DentryInfo *info);
+
+// Invalidation: one name, everything under one directory, or everything
+// (for a new mount). Writers must call these when they change a directory.
+void dentry_invalidate(uint32_t dir, const char *name);
+void dentry_invalidate_dir(uint32_t dir);
+void dentry_flush(void);
+
+typedef struct {
+    uint64_t hits;
+    uint64_t negative_hits;
+    uint64_t misses;
+} DentryStats;
+
+void dentry_get_stats(DentryStats *out);
@@ -1,6 +1,18 @@
 #include <stdint.h>
+#include <stddef.h>
+#include "../io.h"
+#include "../interrupts.h"
+#include "../memory/paging.h"
+#include "../pci/pci.h"
+#include "../smp/spinlock.h"
+#include "../string.h"
+#include "disk.h"
 
 #define ATA_PRIMARY_IO       0x1F0
+#define ATA_PRIMARY_CTRL     0x3F6
+#define ATA_SECONDARY_IO     0x170
+#define ATA_SECONDARY_CTRL   0x376
+
 #define ATA_REG_DATA         0x00
 #define ATA_REG_ERROR        0x01
 #define ATA_REG_SECCOUNT0    0x02
@@ -11,7 +23,22 @@
 #define ATA_REG_COMMAND      0x07
 #define ATA_REG_STATUS       0x07  // Same as COMMAND for reads
 
-#define ATA_CMD_READ_PIO     0x20
+#define ATA_CMD_READ_PIO          0x20
+#define ATA_CMD_READ_PIO_EXT      0x24
+#define ATA_CMD_READ_MULTIPLE_EXT 0x29
+#define ATA_CMD_READ_DMA_EXT      0x25
+#define ATA_CMD_READ_MULTIPLE     0xC4
+#define ATA_CMD_READ_DMA          0xC8
+#define ATA_CMD_WRITE_PIO         0x30
+#define ATA_CMD_WRITE_PIO_EXT     0x34
+#define ATA_CMD_WRITE_MULTIPLE_EXT 0x39
+#define ATA_CMD_WRITE_DMA_EXT     0x35
+#define ATA_CMD_WRITE_MULTIPLE    0xC5
+#define ATA_CMD_WRITE_DMA         0xCA
+#define ATA_CMD_FLUSH_CACHE       0xE7
+#define ATA_CMD_FLUSH_CACHE_EXT   0xEA
+#define ATA_CMD_SET_MULTIPLE      0xC6
+#define ATA_CMD_IDENTIFY          0xEC
 
 // Status bits
 #define ATA_SR_ERR  0x01  // Error
@@ -21,26 +48,55 @@
 #define ATA_SR_RDY  0x40  // Drive ready
 #define ATA_SR_BSY  0x80  // Busy
 
-// I/O helpers
-static inline void outb(uint16_t port, uint8_t val) {
-    __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
-}
+// Bus Master IDE registers (offsets from the channel's BAR4 slice)
+#define BM_REG_COMMAND   0x00
+#define BM_REG_STATUS    0x02
+#define BM_REG_PRDT      0x04
+#define BM_CMD_START     0x01
+#define BM_CMD_READ      0x08  // device to memory
+#define BM_STATUS_ACTIVE 0x01
+#define BM_STATUS_ERR    0x02
+#define BM_STATUS_IRQ    0x04
 
-static inline uint8_t inb(uint16_t port) {
-    uint8_t ret;
-    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
-    return ret;
-}
+#define ATA_IRQ_PRIMARY   0x2E  // IRQ14 after the PIC remap
+#define ATA_IRQ_SECONDARY 0x2F  // IRQ15
 
-static inline void insw(uint16_t port, void *addr, uint32_t count) {
-    __asm__ volatile ("rep insw" : "+D"(addr), "+c"(count) : "d"(port) : "memory");
-}
+#define LBA28_LIMIT (1ULL << 28)
+#define DMA_LIMIT   (1ULL << 32)  // PRD addresses are 32-bit
+#define ATA_PRD_ENTRIES 64        // 128 KB in 4 KB pages needs at most 33
+
+// Physical Region Descriptor: one physically contiguous piece of the buffer
+typedef struct {
+    uint32_t addr;
+    uint16_t bytes;   // 0 means 64 KB
+    uint16_t flags;   // bit 15 marks the last entry
+} __attribute__((packed)) AtaPrd;
+
+typedef struct {
+    uint16_t io;
+    uint16_t ctrl;
+    uint16_t bmide;                // 0 without a bus master
+    uint8_t  irq_driven;           // legacy IRQ14/15 routed to our handler
+    volatile uint8_t irq_fired;
+    volatile uint8_t bm_status;    // bus master status latched by the IRQ
+} AtaChannel;
+
+static AtaDevice ata_devices[ATA_MAX_DEVICES];
+static AtaDevice *boot_device = NULL;  // target of ata_read_sectors
+static AtaChannel ata_channels[2];
+// A PRD table must not cross a 64 KB boundary; page alignment guarantees it
+static AtaPrd ata_prd_tables[2][ATA_PRD_ENTRIES] __attribute__((aligned(4096)));
+
+extern void ata_primary_isr();   // from ASM stub
+extern void ata_secondary_isr();
 
 // Wait for BSY=0 and optionally DRQ=1, return 0 if ready, -1 on error/timeout
-static int ata_wait_ready(int check_drq) {
+static int ata_wait_ready(uint16_t io, int check_drq) {
     for (int i = 0; i < 100000; i++) { // small timeout loop
-        uint8_t status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+        uint8_t status = inb(io + ATA_REG_STATUS);
         if (!(status & ATA_SR_BSY)) {
+            if (status & (ATA_SR_ERR | ATA_SR_DF))
+                return -1; // hardware error or device fault
             if (check_drq) {
                 if (status & ATA_SR_DRQ)
                     return 0;  // ready for data transfer
@@ -52,34 +108,419 @@ static int ata_wait_ready(int check_drq) {
     return -1; // timeout or no DRQ
 }
 
-// --- Safe, read-only 512-byte ATA sector read ---
-int ata_read_sector(uint32_t lba, void *buffer) {
-    // Select drive + LBA bits
-    outb(ATA_PRIMARY_IO + ATA_REG_HDDEVSEL, 0xE0 | ((lba >> 24) & 0x0F));
+// Reading the alternate status four times gives the drive the 400ns it
+// needs after a drive select before its status can be trusted
+static void ata_select_delay(uint16_t ctrl) {
+    for (int i = 0; i < 4; i++)
+        inb(ctrl);
+}
+
+// Copies an IDENTIFY string (byte-swapped words) and trims trailing spaces
+static void ata_copy_string(char *out, const uint16_t *words, int count) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        out[n++] = (char)(words[i] >> 8);
+        out[n++] = (char)(words[i] & 0xFF);
+    }
+    while (n > 0 && out[n - 1] == ' ')
+        n--;
+    out[n] = 0;
+}
+
+// Runs IDENTIFY on one position and fills in `dev`; returns 0 if an ATA
+// disk answered. ATAPI and SATA signatures are left alone.
+static int ata_identify(AtaDevice *dev, int index) {
+    uint16_t io = ata_channels[index / 2].io;
+    uint16_t ctrl = ata_channels[index / 2].ctrl;
+    uint8_t slave = index % 2;
+    uint16_t id[256];
+    if (inb(io + ATA_REG_STATUS) == 0xFF)
+        return -1; // floating bus: no controller on this channel
+    outb(io + ATA_REG_HDDEVSEL, 0xA0 | (slave << 4));
+    ata_select_delay(ctrl);
+    outb(io + ATA_REG_SECCOUNT0, 0);
+    outb(io + ATA_REG_LBA0, 0);
+    outb(io + ATA_REG_LBA1, 0);
+    outb(io + ATA_REG_LBA2, 0);
+    outb(io + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+    if (!inb(io + ATA_REG_STATUS))
+        return -1; // no drive
+    for (int i = 0; i < 100000 && (inb(io + ATA_REG_STATUS) & ATA_SR_BSY); i++)
+        ;
+    if (inb(io + ATA_REG_LBA1) || inb(io + ATA_REG_LBA2))
+        return -1; // packet or SATA device
+    if (ata_wait_ready(io, 1) < 0)
+        return -1;
+    insw(io + ATA_REG_DATA, id, 256);
+    if (!(id[49] & (1 << 9)))
+        return -1; // no LBA support
+
+    dev->present = 1;
+    dev->index = index;
+    dev->channel = index / 2;
+    dev->io = io;
+    dev->ctrl = ctrl;
+    dev->slave = slave;
+    dev->lba48 = (id[83] & (1 << 10)) != 0;
+    dev->sectors = dev->lba48
+        ? ((uint64_t)id[103] << 48) | ((uint64_t)id[102] << 32) | ((uint64_t)id[101] << 16) | id[100]
+        : ((uint32_t)id[61] << 16) | id[60];
+    dev->max_multiple = id[47] & 0xFF;
+    dev->multiple = 0;
+    dev->dma = (id[49] & (1 << 8)) != 0;
+    dev->mwdma_modes = id[63] & 0x07;
+    dev->udma_modes = (id[53] & (1 << 2)) ? (id[88] & 0x7F) : 0;
+    dev->use_dma = dev->dma && ata_channels[dev->channel].bmide;
+    ata_copy_string(dev->model, &id[27], 20);
+    return 0;
+}
+
+// Enables READ MULTIPLE with the largest block the drive reports (IDENTIFY word 47)
+static void ata_enable_multiple(AtaDevice *dev) {
+    if (dev->max_multiple < 2)
+        return;
+    outb(dev->io + ATA_REG_HDDEVSEL, 0xE0 | (dev->slave << 4));
+    ata_select_delay(dev->ctrl);
+    outb(dev->io + ATA_REG_SECCOUNT0, (uint8_t)dev->max_multiple);
+    outb(dev->io + ATA_REG_COMMAND, ATA_CMD_SET_MULTIPLE);
+    if (ata_wait_ready(dev->io, 0) == 0)
+        dev->multiple = dev->max_multiple;
+}
+
+// Finds the PCI IDE controller: channel ports (legacy or native mode) and
+// the bus master block in BAR4 that drives DMA for both channels
+static void ata_probe_controller(void) {
+    static const uint16_t io[2]   = { ATA_PRIMARY_IO, ATA_SECONDARY_IO };
+    static const uint16_t ctrl[2] = { ATA_PRIMARY_CTRL, ATA_SECONDARY_CTRL };
+    for (int c = 0; c < 2; c++) {
+        ata_channels[c].io = io[c];
+        ata_channels[c].ctrl = ctrl[c];
+        ata_channels[c].bmide = 0;
+        ata_channels[c].irq_driven = 1;
+    }
 
-    // Set up sector count and address
-    outb(ATA_PRIMARY_IO + ATA_REG_SECCOUNT0, 1);
-    outb(ATA_PRIMARY_IO + ATA_REG_LBA0, (uint8_t)lba);
-    outb(ATA_PRIMARY_IO + ATA_REG_LBA1, (uint8_t)(lba >> 8));
-    outb(ATA_PRIMARY_IO + ATA_REG_LBA2, (uint8_t)(lba >> 16));
+    const PciDevice *ide = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, 0);
+    if (!ide)
+        return;
+    int is_io;
+    for (int c = 0; c < 2; c++) {
+        if (!(ide->prog_if & (1 << (c * 2))))
+            continue;  // compatibility mode: legacy ports and IRQ
+        uint64_t bar_io = pci_bar(ide, c * 2, &is_io);
+        uint64_t bar_ctrl = pci_bar(ide, c * 2 + 1, &is_io);
+        if (bar_io && bar_ctrl) {
+            ata_channels[c].io = (uint16_t)bar_io;
+            ata_channels[c].ctrl = (uint16_t)bar_ctrl + 2;
+        }
+        ata_channels[c].irq_driven = 0;  // shares a PCI line: poll for completion
+    }
+    uint64_t bm = pci_bar(ide, 4, &is_io);
+    if ((ide->prog_if & 0x80) && bm && is_io) {
+        ata_channels[0].bmide = (uint16_t)bm;
+        ata_channels[1].bmide = (uint16_t)bm + 8;
+        pci_enable(ide, PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+    }
+}
+
+static int ata_block_read(BlockDevice *block, uint64_t lba, uint32_t count, void *buffer) {
+    return ata_device_read(block->driver, lba, count, buffer);
+}
+
+static int ata_block_write(BlockDevice *block, uint64_t lba, uint32_t count, const void *buffer) {
+    return ata_device_write(block->driver, lba, count, buffer);
+}
+
+static int ata_block_flush(BlockDevice *block) {
+    return ata_device_flush(block->driver);
+}
 
-    // Issue READ SECTORS command
-    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, ATA_CMD_READ_PIO);
+static const BlockDeviceOps ata_block_ops = {
+    .read = ata_block_read,
+    .write = ata_block_write,
+    .flush = ata_block_flush,
+};
+
+static void ata_register(AtaDevice *dev) {
+    BlockDevice *block = &dev->block;
+    str_copy(block->name, "ata0", BLOCK_NAME_LEN);
+    block->name[3] += dev->index;
+    block->ops = &ata_block_ops;
+    block->driver = dev;
+    block->block_size = ATA_SECTOR_SIZE;
+    block->blocks = dev->sectors;
+    block->max_request = ATA_MAX_SECTORS;
+    block->kind = dev->use_dma ? "ATA DMA" : "ATA PIO";
+    block->model = dev->model;
+    block_register(block);
+}
+
+int ata_init(void) {
+    int found = 0;
+    boot_device = NULL;
+    ata_probe_controller();
+    idt_set_gate(ATA_IRQ_PRIMARY, (uint64_t)ata_primary_isr);
+    idt_set_gate(ATA_IRQ_SECONDARY, (uint64_t)ata_secondary_isr);
+    idt_load();
+
+    for (int i = 0; i < ATA_MAX_DEVICES; i++) {
+        AtaDevice *dev = &ata_devices[i];
+        dev->present = 0;
+        if (ata_identify(dev, i) < 0)
+            continue;
+        ata_enable_multiple(dev);
+        ata_register(dev);
+        if (!boot_device)
+            boot_device = dev;
+        found++;
+    }
+    return found ? 0 : -1;
+}
+
+const AtaDevice* ata_get_device(int index) {
+    if (index < 0 || index >= ATA_MAX_DEVICES || !ata_devices[index].present)
+        return NULL;
+    return &ata_devices[index];
+}
+
+const AtaDevice* ata_boot_device(void) {
+    return boot_device;
+}
 
-    // Wait for drive to be ready and request data
-    if (ata_wait_ready(1) < 0)
-        return -1; // timeout or not ready
+uint32_t ata_multiple_sectors(void) {
+    return boot_device ? boot_device->multiple : 0;
+}
 
-    uint8_t status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
-    if (status & (ATA_SR_ERR | ATA_SR_DF))
-        return -1; // hardware error or device fault
+// Program the address: 28-bit when it fits (fewer port writes), otherwise
+// LBA48 with the high-order bytes written first. Count 0 means 256 sectors.
+// Returns whether the command must be the EXT one, or -1 if the drive stays
+// busy after the select.
+static int ata_setup(const AtaDevice *dev, uint64_t lba, uint32_t count) {
+    uint16_t io = dev->io;
+    int ext = lba + count > LBA28_LIMIT;
+    if (ext)
+        outb(io + ATA_REG_HDDEVSEL, 0x40 | (dev->slave << 4));
+    else
+        outb(io + ATA_REG_HDDEVSEL, 0xE0 | (dev->slave << 4) | ((lba >> 24) & 0x0F));
+    ata_select_delay(dev->ctrl);
+    int i = 0;
+    while (i < 100000 && (inb(dev->ctrl) & ATA_SR_BSY))
+        i++;
+    if (i == 100000)
+        return -1;
+    if (ext) {
+        outb(io + ATA_REG_SECCOUNT0, (uint8_t)(count >> 8));
+        outb(io + ATA_REG_LBA0, (uint8_t)(lba >> 24));
+        outb(io + ATA_REG_LBA1, (uint8_t)(lba >> 32));
+        outb(io + ATA_REG_LBA2, (uint8_t)(lba >> 40));
+    }
+    outb(io + ATA_REG_SECCOUNT0, (uint8_t)count);
+    outb(io + ATA_REG_LBA0, (uint8_t)lba);
+    outb(io + ATA_REG_LBA1, (uint8_t)(lba >> 8));
+    outb(io + ATA_REG_LBA2, (uint8_t)(lba >> 16));
+    return ext;
+}
 
-    // Transfer 256 words (512 bytes)
-    insw(ATA_PRIMARY_IO + ATA_REG_DATA, buffer, 256);
+// One command of at most ATA_MAX_SECTORS. Under READ MULTIPLE the drive raises
+// DRQ once per block of dev->multiple sectors instead of once per sector.
+static int ata_read_command(const AtaDevice *dev, uint64_t lba, uint32_t count, uint8_t *buf) {
+    uint32_t block = dev->multiple ? dev->multiple : 1;
+    int ext = ata_setup(dev, lba, count);
+    if (ext < 0)
+        return -1;
+    uint8_t cmd = dev->multiple ? (ext ? ATA_CMD_READ_MULTIPLE_EXT : ATA_CMD_READ_MULTIPLE)
+                                : (ext ? ATA_CMD_READ_PIO_EXT : ATA_CMD_READ_PIO);
+    outb(dev->io + ATA_REG_COMMAND, cmd);
+    while (count) {
+        uint32_t n = count < block ? count : block;
+        if (ata_wait_ready(dev->io, 1) < 0)
+            return -1; // timeout, error or device fault
+        insw(dev->io + ATA_REG_DATA, buf, n * 256);
+        buf += n * ATA_SECTOR_SIZE;
+        count -= n;
+    }
 
     // Final wait until BSY clears
-    if (ata_wait_ready(0) < 0)
-        return -1; // timeout
+    return ata_wait_ready(dev->io, 0);
+}
+
+// Same as ata_read_command in the other direction: the drive raises DRQ
+// for each block it is ready to accept
+static int ata_write_command(const AtaDevice *dev, uint64_t lba, uint32_t count, const uint8_t *buf) {
+    uint32_t block = dev->multiple ? dev->multiple : 1;
+    int ext = ata_setup(dev, lba, count);
+    if (ext < 0)
+        return -1;
+    uint8_t cmd = dev->multiple ? (ext ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_MULTIPLE)
+                                : (ext ? ATA_CMD_WRITE_PIO_EXT : ATA_CMD_WRITE_PIO);
+    outb(dev->io + ATA_REG_COMMAND, cmd);
+    while (count) {
+        uint32_t n = count < block ? count : block;
+        if (ata_wait_ready(dev->io, 1) < 0)
+            return -1;
+        outsw(dev->io + ATA_REG_DATA, buf, n * 256);
+        buf += n * ATA_SECTOR_SIZE;
+        count -= n;
+    }
+    return ata_wait_ready(dev->io, 0);
+}
+
+// ==== Bus Master DMA ====
+// Runs from IRQ14/15: latch and clear the bus master status, then read the
+// drive status, which deasserts its interrupt line
+void ata_irq_handler_c(uint64_t channel) {
+    AtaChannel *ch = &ata_channels[channel & 1];
+    if (ch->bmide) {
+        uint8_t status = inb(ch->bmide + BM_REG_STATUS);
+        ch->bm_status = status;
+        outb(ch->bmide + BM_REG_STATUS, status | BM_STATUS_IRQ | BM_STATUS_ERR);
+    }
+    inb(ch->io + ATA_REG_STATUS);
+    ch->irq_fired = 1;
+}
+
+// Describes `bytes` of buf, page by page, merging physically contiguous
+// pages. Returns the entry count, or -1 if the buffer is not DMA-able
+// (odd address, above 4 GB, or too fragmented).
+static int ata_build_prd(AtaPrd *prd, uint8_t *buf, uint32_t bytes) {
+    if ((uintptr_t)buf & 1)
+        return -1;
+    int n = 0;
+    uint32_t run = 0;  // bytes in prd[n - 1]
+    while (bytes) {
+        uintptr_t virt = (uintptr_t)buf;
+        uint32_t len = PAGE_SIZE_4K - (virt & (PAGE_SIZE_4K - 1));
+        if (len > bytes)
+            len = bytes;
+        (void)*(volatile uint8_t *)buf;  // commit a demand-paged heap page first
+        uint64_t phys = paging_virt_to_phys(virt);
+        if (!phys || phys + len > DMA_LIMIT)
+            return -1;
+        if (n && (uint64_t)prd[n - 1].addr + run == phys && (prd[n - 1].addr >> 16) == ((phys + len - 1) >> 16)) {
+            run += len;
+        } else {
+            if (n == ATA_PRD_ENTRIES)
+                return -1;
+            prd[n].addr = (uint32_t)phys;
+            prd[n].flags = 0;
+            n++;
+            run = len;
+        }
+        prd[n - 1].bytes = (uint16_t)run;  // a full 64 KB wraps to 0, as the spec wants
+        buf += len;
+        bytes -= len;
+    }
+    prd[n - 1].flags = 0x8000;
+    return n;
+}
+
+// Waits until the channel interrupts. Before interrupts are enabled (early
+// boot) or on a channel without a private IRQ, polls the bus master instead.
+// Either way the wait is bounded, so a lost IRQ ends in -1 and the caller
+// falls back to PIO.
+static int ata_dma_wait(AtaChannel *ch) {
+    for (int i = 0; i < 10000000; i++) {
+        uint64_t flags = irq_save();
+        if (ch->irq_fired) {
+            irq_restore(flags);
+            return 0;
+        }
+        if ((flags & 0x200) && ch->irq_driven) {
+            // No timer is running to wake a hlt, so spin with interrupts on
+            __asm__ volatile("sti; pause" : : : "memory");
+            continue;
+        }
+        irq_restore(flags);
+        if (inb(ch->bmide + BM_REG_STATUS) & BM_STATUS_IRQ) {
+            ata_irq_handler_c(ch == &ata_channels[1]);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// One DMA command of at most ATA_MAX_SECTORS, using the PRD table built
+// by the caller. `write` sends memory to the device.
+static int ata_dma_command(const AtaDevice *dev, uint64_t lba, uint32_t count, int write) {
+    AtaChannel *ch = &ata_channels[dev->channel];
+    uint16_t bm = ch->bmide;
+    outb(bm + BM_REG_COMMAND, 0);
+    outl(bm + BM_REG_PRDT, (uint32_t)paging_virt_to_phys((uint64_t)ata_prd_tables[dev->channel]));
+    outb(bm + BM_REG_STATUS, inb(bm + BM_REG_STATUS) | BM_STATUS_IRQ | BM_STATUS_ERR);
+    uint8_t direction = write ? 0 : BM_CMD_READ;
+    outb(bm + BM_REG_COMMAND, direction);
+
+    ch->irq_fired = 0;
+    ch->bm_status = 0;
+    int ext = ata_setup(dev, lba, count);
+    if (ext < 0)
+        return -1;
+    uint8_t cmd = write ? (ext ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA)
+                        : (ext ? ATA_CMD_READ_DMA_EXT : ATA_CMD_READ_DMA);
+    outb(dev->io + ATA_REG_COMMAND, cmd);
+    outb(bm + BM_REG_COMMAND, direction | BM_CMD_START);
+
+    int result = ata_dma_wait(ch);
+    outb(bm + BM_REG_COMMAND, 0);
+    uint8_t status = inb(dev->io + ATA_REG_STATUS);
+    if (result < 0 || (ch->bm_status & BM_STATUS_ERR) || (status & (ATA_SR_ERR | ATA_SR_DF)))
+        return -1;
+    return 0;
+}
+
+// DMA when the device and buffer allow it, PIO otherwise. A device whose
+// DMA transfer fails is switched to PIO for good.
+static int ata_transfer(const AtaDevice *dev, uint64_t lba, uint32_t count, uint8_t *buf, int write) {
+    if (dev->use_dma && ata_build_prd(ata_prd_tables[dev->channel], buf, count * ATA_SECTOR_SIZE) > 0) {
+        if (ata_dma_command(dev, lba, count, write) == 0)
+            return 0;
+        ata_devices[dev->index].use_dma = 0;
+        ata_devices[dev->index].block.kind = "ATA PIO";
+    }
+    return write ? ata_write_command(dev, lba, count, buf)
+                 : ata_read_command(dev, lba, count, buf);
+}
+
+static int ata_device_io(const AtaDevice *dev, uint64_t lba, uint32_t count, uint8_t *buf, int write) {
+    if (!dev || !dev->present || lba + count > dev->sectors)
+        return -1;
+    if (!dev->lba48 && lba + count > LBA28_LIMIT)
+        return -1;
+    while (count) {
+        uint32_t n = count < ATA_MAX_SECTORS ? count : ATA_MAX_SECTORS;
+        if (ata_transfer(dev, lba, n, buf, write) < 0)
+            return -1;
+        lba += n;
+        buf += n * ATA_SECTOR_SIZE;
+        count -= n;
+    }
+    return 0;
+}
+
+int ata_device_read(const AtaDevice *dev, uint64_t lba, uint32_t count, void *buffer) {
+    return ata_device_io(dev, lba, count, buffer, 0);
+}
+
+// The bus master only reads from the buffer on a write, so the cast is safe
+int ata_device_write(const AtaDevice *dev, uint64_t lba, uint32_t count, const void *buffer) {
+    return ata_device_io(dev, lba, count, (uint8_t *)buffer, 1);
+}
 
-    return 0; // success
+int ata_device_flush(const AtaDevice *dev) {
+    if (!dev || !dev->present)
+        return -1;
+    outb(dev->io + ATA_REG_HDDEVSEL, 0xE0 | (dev->slave << 4));
+    ata_select_delay(dev->ctrl);
+    outb(dev->io + ATA_REG_COMMAND, dev->lba48 ? ATA_CMD_FLUSH_CACHE_EXT : ATA_CMD_FLUSH_CACHE);
+    for (int i = 0; i < 10000000 && (inb(dev->io + ATA_REG_STATUS) & ATA_SR_BSY); i++)
+        ;  // a flush can take far longer than a sector transfer
+    return ata_wait_ready(dev->io, 0);
+}
+
+int ata_read_sectors(uint64_t lba, uint32_t count, void *buffer) {
+    return ata_device_read(boot_device, lba, count, buffer);
+}
+
+// --- Safe, read-only 512-byte ATA sector read ---
+int ata_read_sector(uint64_t lba, void *buffer) {
+    return ata_read_sectors(lba, 1, buffer);
 }
@@ -1,6 +1,65 @@
 #pragma once
 #include <stdint.h>
+#include "block.h"
 
-// Reads a 512-byte sector from the disk at given LBA into buffer.
+#define ATA_SECTOR_SIZE 512
+#define ATA_MAX_SECTORS 256   // per command; larger reads are split
+#define ATA_MAX_DEVICES 4     // primary/secondary channel, master/slave
+
+typedef struct {
+    uint8_t  present;
+    uint8_t  index;           // position 0..3
+    uint8_t  channel;         // 0 = primary, 1 = secondary
+    uint8_t  slave;           // 0 = master, 1 = slave
+    uint8_t  lba48;           // READ SECTORS EXT supported
+    uint8_t  dma;             // DMA transfers supported
+    uint8_t  use_dma;         // transfers go through the bus master
+    uint16_t io;              // command block base port
+    uint16_t ctrl;            // control block (alternate status) port
+    uint64_t sectors;         // capacity in 512-byte sectors
+    uint32_t max_multiple;    // largest READ MULTIPLE block the drive accepts
+    uint32_t multiple;        // block currently enabled (0 = off)
+    uint8_t  mwdma_modes;     // bitmask of supported multiword DMA modes
+    uint8_t  udma_modes;      // bitmask of supported Ultra DMA modes
+    char     model[41];
+    BlockDevice block;        // registered as ata0..ata3 by position
+} AtaDevice;
+
+// Locates the PCI IDE controller (call pci_init first), identifies the four
+// IDE positions and enables READ MULTIPLE on every disk found. Disks behind
+// a bus master read by DMA, completing on IRQ14/15 once interrupts are on.
+// Every disk is registered as a block device; the first becomes the boot device.
+// Returns 0 if at least one disk answered, -1 otherwise.
+int ata_init(void);
+
+// Device at position 0..3 (primary master, primary slave, secondary
+// master, secondary slave), or NULL if nothing is there.
+const AtaDevice* ata_get_device(int index);
+const AtaDevice* ata_boot_device(void);
+
+// IRQ14/15 entry, called by the ASM stubs with the channel index
+void ata_irq_handler_c(uint64_t channel);
+
+// Sectors transferred per DRQ block on the boot device (0 if READ MULTIPLE is off).
+uint32_t ata_multiple_sectors(void);
+
+// Reads `count` consecutive sectors from `dev`, issuing one command per
+// ATA_MAX_SECTORS and switching to LBA48 commands past 128 GB. Buffers that
+// cannot be described to the bus master fall back to PIO.
+// Returns 0 on success, -1 on failure.
+int ata_device_read(const AtaDevice *dev, uint64_t lba, uint32_t count, void *buffer);
+
+// Writes `count` consecutive sectors to `dev`, split and addressed like
+// ata_device_read. Returns 0 on success, -1 on failure.
+int ata_device_write(const AtaDevice *dev, uint64_t lba, uint32_t count, const void *buffer);
+
+// Commits the drive's write cache to the medium. Returns 0 on success, -1 on failure.
+int ata_device_flush(const AtaDevice *dev);
+
+// Reads a 512-byte sector from the boot device at given LBA into buffer.
+// Returns 0 on success, -1 on failure.
+int ata_read_sector(uint64_t lba, void *buffer);
+
+// Reads `count` consecutive sectors from the boot device into buffer.
 // Returns 0 on success, -1 on failure.
-int ata_read_sector(uint32_t lba, void *buffer);
+int ata_read_sectors(uint64_t lba, uint32_t count, void *buffer);
@@ -1,11 +1,14 @@
 #include "fat32.h"
-#include "disk.h"
+#include "bcache.h"
+#include "dentry.h"
+#include "../memory/memory.h"
 #include "../string.h"
 
 #define BUFFER_SIZE   4096
 #define MAX_PATH_LEN  256
 
 static uint8_t file_buffer[BUFFER_SIZE];
+static uint8_t cluster_buf[64 * SECTOR_SIZE]; // directory cluster being scanned
 static char current_dir_path[MAX_PATH_LEN] = "/home";
 const char *fat32_get_current_path(void) { return current_dir_path; }
 
@@ -15,6 +18,14 @@ static uint32_t fat_begin_lba;
 static uint32_t first_data_sector;
 static uint32_t cluster_size;
 static uint32_t current_dir_cluster = 0;
+static uint32_t partition_lba;
+static uint32_t total_clusters;             // data clusters: 2 .. total_clusters + 1
+static BlockDevice *volume = NULL;          // device holding the mounted volume
+
+#define FAT_EOC          0x0FFFFFFF
+#define FAT_ATTR_DIR     0x10
+#define FAT_ATTR_ARCHIVE 0x20
+#define FAT_DEFAULT_DATE 0x0021             // 1980-01-01: there is no clock to read
 
 // -----------------------------------------------------------------------------
 // On-disk structures for LFN
@@ -37,15 +48,422 @@ static inline uint32_t cluster_to_lba(uint32_t cluster) {
     return first_data_sector + ((cluster - 2) * bpb.SecPerClus);
 }
 
+// Reads that go around the buffer cache still see what it holds dirty
+static int disk_read(uint64_t lba, uint32_t count, void *buf) {
+    if (block_read(volume, lba, count, buf) != 0)
+        return -1;
+    bcache_overlay(volume, lba, count, buf);
+    return 0;
+}
+
+// Reads a whole cluster with a single multi-sector command
+static inline int read_cluster(uint32_t cluster, void *dst) {
+    return disk_read(cluster_to_lba(cluster), bpb.SecPerClus, dst);
+}
+
+// Directory clusters are read again and again by every path walk, so they
+// go through the buffer cache
+static inline int read_dir_cluster(uint32_t cluster, void *dst) {
+    return bcache_read(volume, cluster_to_lba(cluster), bpb.SecPerClus, dst);
+}
+
+// -----------------------------------------------------------------------------
+// FAT cache: the whole table is loaded at mount when it is at most
+// FAT_PRELOAD_MAX bytes and the heap has room for it; otherwise the most
+// recently used FAT_WINDOWS windows of FAT_WINDOW_SECTORS stay in memory.
+// Either way a chain hop is a memory lookup unless it leaves every window.
+// -----------------------------------------------------------------------------
+#define FAT_PRELOAD_MAX    (8 * 1024 * 1024)
+#define FAT_WINDOW_SECTORS 16
+#define FAT_WINDOWS        8
+#define FAT_WINDOW_ENTRIES (FAT_WINDOW_SECTORS * SECTOR_SIZE / 4)
+
+typedef struct {
+    uint8_t  valid;
+    uint32_t first;      // first entry held
+    uint32_t last_used;  // fat_clock at the last lookup
+    uint32_t entries[FAT_WINDOW_ENTRIES];
+} FatWindow;
+
+static uint32_t *fat_table = NULL;  // whole FAT, or NULL when windowed
+static uint32_t fat_entries = 0;    // entries in one FAT copy
+static FatWindow fat_windows[FAT_WINDOWS];
+static uint32_t fat_clock = 0;
+
+// Drops the previous volume's FAT and tries to preload the new one
+static void fat_cache_load(void) {
+    free(fat_table);
+    fat_table = NULL;
+    for (int i = 0; i < FAT_WINDOWS; i++)
+        fat_windows[i].valid = 0;
+    fat_entries = bpb.FATSz32 * (bpb.BytsPerSec / 4);
+
+    uint64_t bytes = (uint64_t)bpb.FATSz32 * bpb.BytsPerSec;
+    if (bytes > FAT_PRELOAD_MAX)
+        return;
+    uint32_t *table = malloc(bytes);
+    if (!table)
+        return;
+    if (disk_read(fat_begin_lba, bpb.FATSz32, table) != 0) {
+        free(table);
+        return;
+    }
+    fat_table = table;
+}
+
+// FAT entry of `cluster` without the reserved top bits (0 if unreadable)
+static uint32_t fat_entry(uint32_t cluster) {
+    if (cluster >= fat_entries)
+        return 0;
+    if (fat_table)
+        return fat_table[cluster] & 0x0FFFFFFF;
+
+    uint32_t first = cluster - cluster % FAT_WINDOW_ENTRIES;
+    FatWindow *w = NULL;
+    FatWindow *victim = &fat_windows[0];
+    for (int i = 0; i < FAT_WINDOWS && !w; i++) {
+        FatWindow *c = &fat_windows[i];
+        if (c->valid && c->first == first)
+            w = c;
+        else if (!c->valid || (victim->valid && c->last_used < victim->last_used))
+            victim = c;
+    }
+    if (!w) {
+        uint32_t sector = first / (bpb.BytsPerSec / 4);
+        uint32_t count = bpb.FATSz32 - sector < FAT_WINDOW_SECTORS ? bpb.FATSz32 - sector
+                                                                  : FAT_WINDOW_SECTORS;
+        victim->valid = 0;
+        if (disk_read(fat_begin_lba + sector, count, victim->entries) != 0)
+            return 0;
+        victim->first = first;
+        victim->valid = 1;
+        w = victim;
+    }
+    w->last_used = ++fat_clock;
+    return w->entries[cluster - first] & 0x0FFFFFFF;
+}
+
+// Next cluster of a chain, 0 at its end (or on a free/bad entry)
 static inline int32_t get_next_cluster(uint32_t cluster) {
-    uint32_t fat_offset = cluster * 4;
-    uint32_t fat_sector = fat_begin_lba + (fat_offset / bpb.BytsPerSec);
-    uint32_t ent_offset = fat_offset % bpb.BytsPerSec;
-    uint8_t sector_buf[512];
-    ata_read_sector(fat_sector, sector_buf);
-    uint32_t *entry = (uint32_t *)(sector_buf + ent_offset);
-    uint32_t next = *entry & 0x0FFFFFFF;
-    return (next >= 0x0FFFFFF8) ? 0 : next;
+    uint32_t next = fat_entry(cluster);
+    return (next < 2 || next >= 0x0FFFFFF7) ? 0 : next;
+}
+
+// Sets the FAT entry of `cluster` (keeping its reserved top bits) in memory
+// and in every FAT copy, through the write-back cache so that updates to
+// one FAT sector reach the disk together
+static int fat_set(uint32_t cluster, uint32_t value) {
+    uint32_t per_sector = bpb.BytsPerSec / 4;
+    uint32_t sector = cluster / per_sector;
+    uint32_t buf[SECTOR_SIZE / 4];
+    uint32_t *entries = buf;
+    if (cluster < 2 || cluster >= fat_entries)
+        return -1;
+    if (fat_table) {
+        fat_table[cluster] = (fat_table[cluster] & 0xF0000000) | (value & 0x0FFFFFFF);
+        entries = fat_table + sector * per_sector;
+    } else {
+        if (bcache_read(volume, fat_begin_lba + sector, 1, buf) != 0)
+            return -1;
+        uint32_t *e = &buf[cluster % per_sector];
+        *e = (*e & 0xF0000000) | (value & 0x0FFFFFFF);
+        for (int i = 0; i < FAT_WINDOWS; i++) {
+            FatWindow *w = &fat_windows[i];
+            if (w->valid && cluster - w->first < FAT_WINDOW_ENTRIES)
+                w->entries[cluster - w->first] = *e;
+        }
+    }
+    for (uint32_t copy = 0; copy < bpb.NumFATs; copy++)
+        if (bcache_write(volume, fat_begin_lba + copy * bpb.FATSz32 + sector, 1, entries) != 0)
+            return -1;
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// FSInfo: the free cluster count and the next-free hint, so allocation starts
+// where the last one ended instead of scanning the FAT from the beginning.
+// Kept in memory and written back by fat32_sync.
+// -----------------------------------------------------------------------------
+#define FSINFO_LEAD_SIG    0x41615252
+#define FSINFO_STRUCT_SIG  0x61417272
+#define FSINFO_TRAIL_SIG   0xAA550000
+#define FSINFO_UNKNOWN     0xFFFFFFFF
+
+static uint32_t fsinfo_lba = 0;             // 0 if the volume has no valid FSInfo
+static uint32_t free_count = FSINFO_UNKNOWN;
+static uint32_t next_free = 2;
+static int fsinfo_dirty = 0;
+
+static void fsinfo_load(void) {
+    uint32_t sector[SECTOR_SIZE / 4];
+    fsinfo_lba = 0;
+    free_count = FSINFO_UNKNOWN;
+    next_free = 2;
+    fsinfo_dirty = 0;
+    if (!bpb.FSInfo || bpb.FSInfo >= bpb.RsvdSecCnt)
+        return;
+    if (disk_read(partition_lba + bpb.FSInfo, 1, sector) != 0)
+        return;
+    if (sector[0] != FSINFO_LEAD_SIG || sector[484 / 4] != FSINFO_STRUCT_SIG
+            || sector[508 / 4] != FSINFO_TRAIL_SIG)
+        return;
+    fsinfo_lba = partition_lba + bpb.FSInfo;
+    if (sector[488 / 4] <= total_clusters)
+        free_count = sector[488 / 4];
+    if (sector[492 / 4] >= 2 && sector[492 / 4] < total_clusters + 2)
+        next_free = sector[492 / 4];
+}
+
+static int fsinfo_store(void) {
+    uint32_t sector[SECTOR_SIZE / 4];
+    if (!fsinfo_dirty || !fsinfo_lba)
+        return 0;
+    if (bcache_read(volume, fsinfo_lba, 1, sector) != 0)
+        return -1;
+    sector[488 / 4] = free_count;
+    sector[492 / 4] = next_free;
+    if (bcache_write(volume, fsinfo_lba, 1, sector) != 0)
+        return -1;
+    fsinfo_dirty = 0;
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Free space: one bit per data cluster, set while it is in use, built by a
+// single pass over the FAT (from memory when the FAT is preloaded, at mount;
+// otherwise on first need). The allocator skips 64 used clusters per word
+// and free_count stays exact as clusters come and go, so neither usage
+// queries nor allocation rescan the FAT.
+// -----------------------------------------------------------------------------
+#define FREE_MAP_MAX (1024 * 1024)  // bytes of bitmap: volumes up to 8M clusters
+
+static uint64_t *free_map = NULL;   // bit (cluster - 2); NULL if too big or no memory
+static int free_counted = 0;        // free_count comes from a FAT pass, not FSInfo
+
+static inline void free_map_set(uint32_t cluster, int used) {
+    if (!free_map)
+        return;
+    uint64_t bit = 1ULL << ((cluster - 2) % 64);
+    if (used)
+        free_map[(cluster - 2) / 64] |= bit;
+    else
+        free_map[(cluster - 2) / 64] &= ~bit;
+}
+
+// Counts free clusters and fills the bitmap, reading the FAT in large
+// requests when it is not in memory
+static void free_map_build(void) {
+    uint32_t words = (total_clusters + 63) / 64;
+    free(free_map);
+    free_map = NULL;
+    if ((uint64_t)words * sizeof(uint64_t) <= FREE_MAP_MAX && words)
+        free_map = malloc(words * sizeof(uint64_t));
+    if (free_map) {
+        memset(free_map, 0, words * sizeof(uint64_t));
+        for (uint32_t c = total_clusters; c < words * 64; c++)
+            free_map[c / 64] |= 1ULL << (c % 64);  // past the end: never free
+    }
+
+    const uint32_t per_sector = bpb.BytsPerSec / 4;
+    const uint32_t chunk = sizeof(cluster_buf) / SECTOR_SIZE;
+    uint32_t count = 0;
+    uint32_t last = total_clusters + 1;
+    for (uint32_t s = 0; s < bpb.FATSz32 && s * per_sector <= last; s += chunk) {
+        const uint32_t *entries;
+        if (fat_table) {
+            entries = fat_table + s * per_sector;
+        } else {
+            uint32_t n = bpb.FATSz32 - s < chunk ? bpb.FATSz32 - s : chunk;
+            if (disk_read(fat_begin_lba + s, n, cluster_buf) != 0) {
+                free(free_map);  // an unreadable FAT leaves nothing to trust
+                free_map = NULL;
+                return;
+            }
+            entries = (const uint32_t *)cluster_buf;
+        }
+        for (uint32_t i = 0; i < chunk * per_sector; i++) {
+            uint32_t c = s * per_sector + i;
+            if (c < 2)
+                continue;
+            if (c > last)
+                break;
+            if (!(entries[i] & 0x0FFFFFFF))
+                count++;
+            else
+                free_map_set(c, 1);
+        }
+    }
+    if (count != free_count && volume->ops->write)
+        fsinfo_dirty = 1;  // FSInfo was stale: store the real count on sync
+    free_count = count;
+    free_counted = 1;
+}
+
+// First free cluster at or after `from`, wrapping around; 0 if none
+static uint32_t free_map_next(uint32_t from) {
+    uint32_t words = (total_clusters + 63) / 64;
+    uint32_t start = (from - 2) / 64;
+    uint64_t below = (1ULL << ((from - 2) % 64)) - 1;
+    for (uint32_t i = 0; i <= words; i++) {
+        uint32_t w = (start + i) % words;
+        uint64_t free_bits = ~free_map[w];
+        if (i == 0)
+            free_bits &= ~below;          // the start word from `from` on ...
+        else if (i == words)
+            free_bits &= below;           // ... and its beginning last
+        if (free_bits)
+            return 2 + w * 64 + (uint32_t)__builtin_ctzll(free_bits);
+    }
+    return 0;
+}
+
+// Without a bitmap: FAT entries one by one from `from`, wrapping around
+static uint32_t fat_scan_next(uint32_t from) {
+    uint32_t last = total_clusters + 1;
+    uint32_t cluster = from;
+    for (uint32_t i = 0; i < total_clusters; i++, cluster++) {
+        if (cluster < 2 || cluster > last)
+            cluster = 2;
+        if (fat_entry(cluster) == 0)
+            return cluster;
+    }
+    return 0;
+}
+
+// Takes a free cluster, searching from the next-free hint, marks it
+// end-of-chain and links it after `prev` (0 starts a new chain).
+// Returns the cluster, or 0 if the volume is full.
+static uint32_t alloc_cluster(uint32_t prev) {
+    uint32_t last = total_clusters + 1;
+    if (!free_counted)
+        free_map_build();
+    if (free_counted && free_count == 0)
+        return 0;
+    if (next_free < 2 || next_free > last)
+        next_free = 2;
+    uint32_t cluster = free_map ? free_map_next(next_free) : fat_scan_next(next_free);
+    if (!cluster) {
+        free_count = 0;
+        fsinfo_dirty = 1;
+        return 0;
+    }
+    if (fat_set(cluster, FAT_EOC) != 0 || (prev && fat_set(prev, cluster) != 0))
+        return 0;
+    free_map_set(cluster, 1);
+    next_free = cluster < last ? cluster + 1 : 2;
+    if (free_count != FSINFO_UNKNOWN)
+        free_count--;
+    fsinfo_dirty = 1;
+    return cluster;
+}
+
+// Returns every cluster of the chain starting at `cluster` to the free pool
+static int free_chain(uint32_t cluster) {
+    for (uint32_t i = 0; cluster && i < total_clusters; i++) {
+        uint32_t next = get_next_cluster(cluster);
+        if (fat_set(cluster, 0) != 0)
+            return -1;
+        free_map_set(cluster, 0);
+        if (free_count != FSINFO_UNKNOWN)
+            free_count++;
+        if (cluster < next_free)
+            next_free = cluster;
+        fsinfo_dirty = 1;
+        cluster = next;
+    }
+    return 0;
+}
+
+static inline uint32_t clusters_for(uint32_t bytes) {
+    return (uint32_t)(((uint64_t)bytes + cluster_size - 1) / cluster_size);
+}
+
+// Grows the chain starting at *first to at least `clusters` clusters; an
+// empty file (*first == 0) gets its first cluster here. Returns 0, or -2 if
+// the volume filled up on the way.
+static int chain_extend(uint32_t *first, uint32_t clusters) {
+    uint32_t have = 0, last = 0;
+    for (uint32_t c = *first; c && have < clusters; c = get_next_cluster(c)) {
+        last = c;
+        have++;
+    }
+    while (have < clusters) {
+        uint32_t c = alloc_cluster(last);
+        if (!c)
+            return -2;
+        if (!*first)
+            *first = c;
+        last = c;
+        have++;
+    }
+    return 0;
+}
+
+// Cuts the chain starting at *first down to `clusters` clusters
+static int chain_trim(uint32_t *first, uint32_t clusters) {
+    if (!clusters) {
+        int result = free_chain(*first);
+        *first = 0;
+        return result;
+    }
+    uint32_t c = *first;
+    for (uint32_t i = 1; c && i < clusters; i++)
+        c = get_next_cluster(c);
+    uint32_t rest = c ? get_next_cluster(c) : 0;
+    if (!rest)
+        return 0;
+    if (fat_set(c, FAT_EOC) != 0)
+        return -1;
+    return free_chain(rest);
+}
+
+// Writes `size` bytes at `offset` into the chain starting at `first`, which
+// must already be long enough; NULL data writes zeros. Whole sectors go to
+// the write-back cache as they are, so a cluster written piece by piece
+// still reaches the disk as one request; partial sectors are patched.
+static int chain_write(uint32_t first, uint32_t offset, const uint8_t *data, uint32_t size) {
+    static const uint8_t zeros[SECTOR_SIZE];
+    uint8_t sector[SECTOR_SIZE];
+    uint32_t cluster = first;
+    for (uint32_t n = offset / cluster_size; n && cluster; n--)
+        cluster = get_next_cluster(cluster);
+    while (size) {
+        if (!cluster)
+            return -1;
+        uint32_t in_cluster = offset % cluster_size;
+        uint32_t in_sector = in_cluster % bpb.BytsPerSec;
+        uint64_t lba = cluster_to_lba(cluster) + in_cluster / bpb.BytsPerSec;
+        uint32_t n;
+        if (!in_sector && size >= bpb.BytsPerSec) {
+            uint32_t sectors = (cluster_size - in_cluster) / bpb.BytsPerSec;
+            if (sectors > size / bpb.BytsPerSec)
+                sectors = size / bpb.BytsPerSec;
+            if (!data)
+                sectors = 1;
+            n = sectors * bpb.BytsPerSec;
+            if (bcache_write(volume, lba, sectors, data ? data : zeros) != 0)
+                return -1;
+        } else {
+            n = bpb.BytsPerSec - in_sector;
+            if (n > size)
+                n = size;
+            if (bcache_read(volume, lba, 1, sector) != 0)
+                return -1;
+            if (data)
+                memcpy(sector + in_sector, data, n);
+            else
+                memset(sector + in_sector, 0, n);
+            if (bcache_write(volume, lba, 1, sector) != 0)
+                return -1;
+        }
+        if (data)
+            data += n;
+        offset += n;
+        size -= n;
+        if (offset % cluster_size == 0)
+            cluster = get_next_cluster(cluster);
+    }
+    return 0;
 }
 
 // Build a short 8.3 lowercase name into out[13]
@@ -67,22 +485,45 @@ static void make_short_name_lower(const uint8_t Name[11], char out[13]) {
     out[p] = 0;
 }
 
-// Append up to 13 chars from an LFN entry (UTF-16 -> ASCII) to the **front** of buffer
-static void lfn_prepend_piece(char *lfn_buf, const struct FAT32_LFN_Entry *lfn, int maxlen) {
-    char temp[14]; int pos = 0;
-    int j;
-    for (j = 0; j < 5; j++)   { uint16_t c = lfn->Name1[j]; if (!c || c == 0xFFFF) break; temp[pos++] = (char)c; }
-    for (j = 0; j < 6; j++)   { uint16_t c = lfn->Name2[j]; if (!c || c == 0xFFFF) break; temp[pos++] = (char)c; }
-    for (j = 0; j < 2; j++)   { uint16_t c = lfn->Name3[j]; if (!c || c == 0xFFFF) break; temp[pos++] = (char)c; }
-    temp[pos] = 0;
+// Long name assembled from LFN entries (UTF-16 -> ASCII). The fragments come
+// last-first on disk and each carries its sequence number, so its 13
+// characters go straight to their offset in the name; nothing is shifted.
+typedef struct {
+    char name[256];
+    int  next;   // sequence number expected next, 0 once complete
+    int  valid;
+} LfnName;
+
+// Byte offsets of the 13 UTF-16 characters inside an LFN entry
+static const uint8_t lfn_char_offsets[13] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+
+static inline void lfn_reset(LfnName *l) { l->valid = 0; }
+
+static void lfn_add(LfnName *l, const struct FAT32_LFN_Entry *lfn) {
+    const uint8_t *raw = (const uint8_t *)lfn;
+    int seq = lfn->Ord & 0x1F;
+    if (lfn->Ord & 0x40) {  // last fragment, seen first
+        l->valid = 1;
+        l->next = seq;
+    }
+    if (!l->valid || seq != l->next || seq < 1 || seq > 19) {
+        l->valid = 0;
+        return;
+    }
+    int pos = (seq - 1) * 13;
+    for (int i = 0; i < 13; i++) {
+        uint16_t c = raw[lfn_char_offsets[i]] | (raw[lfn_char_offsets[i] + 1] << 8);
+        if (!c || c == 0xFFFF) break;
+        l->name[pos++] = (char)c;
+    }
+    if (lfn->Ord & 0x40)
+        l->name[pos] = 0;
+    l->next = seq - 1;
+}
 
-    // prepend temp to lfn_buf
-    char merged[256];
-    int i = 0, k = 0;
-    while (temp[i] && i < maxlen - 1) { merged[i] = temp[i]; i++; }
-    while (lfn_buf[k] && i < maxlen - 1) { merged[i++] = lfn_buf[k++]; }
-    merged[i] = 0;
-    str_copy(lfn_buf, merged, maxlen);
+// The long name of the short entry that follows, NULL if there is none
+static inline const char* lfn_get(const LfnName *l) {
+    return l->valid && l->next == 0 ? l->name : NULL;
 }
 
 // Choose display/match name (LFN if present, else short)
@@ -93,6 +534,557 @@ static const char* choose_name(const char *lfn, const char *shortnm) {
 // Compare ASCII case-insensitive (use your provided strcmp/strcasecmp if available)
 int strcasecmp(const char *s1, const char *s2);
 
+// -----------------------------------------------------------------------------
+// Directory index: each directory parsed once into an entry array (names in
+// one pool) with a hash table on the lowercase name. The DIR_INDEX_SLOTS most
+// recently used directories stay parsed; lookups and ls work on these.
+// -----------------------------------------------------------------------------
+#define DIR_INDEX_SLOTS 8
+#define DIR_INDEX_END   0xFFFFFFFF
+
+typedef struct {
+    uint32_t name;      // offset in the index's name pool
+    uint32_t hash;
+    uint32_t next;      // next entry in the same bucket, DIR_INDEX_END at the end
+    uint8_t  attr;
+    uint8_t  lfn_slots;    // LFN entries right before the short entry
+    uint8_t  short_name[11];
+    uint32_t slot;         // position of the short entry in the directory
+    uint32_t cluster;
+    uint32_t size;
+} DirIndexEntry;
+
+typedef struct {
+    uint32_t dir;            // first cluster, 0 = free slot
+    uint32_t last_used;
+    uint32_t count;
+    uint32_t bucket_mask;
+    DirIndexEntry *entries;
+    uint32_t *buckets;
+    char *names;
+} DirIndex;
+
+static DirIndex dir_indexes[DIR_INDEX_SLOTS];
+static uint32_t dir_index_clock = 0;
+
+static uint32_t name_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++)
+        hash = (hash ^ (uint8_t)to_lower(*name)) * 16777619u;
+    return hash;
+}
+
+static void dir_index_release(DirIndex *index) {
+    free(index->entries);
+    free(index->buckets);
+    free(index->names);
+    memset(index, 0, sizeof(*index));
+}
+
+// Drops the parsed form of `dir` (every directory when 0); writers call this
+// together with dentry_invalidate_dir when they change a directory
+static void dir_index_invalidate(uint32_t dir) {
+    for (int i = 0; i < DIR_INDEX_SLOTS; i++)
+        if (dir_indexes[i].dir && (!dir || dir_indexes[i].dir == dir))
+            dir_index_release(&dir_indexes[i]);
+}
+
+// Grows *array (of `size`-byte items) so that `needed` items fit
+static int grow_array(void **array, uint32_t *capacity, uint32_t needed, size_t size) {
+    if (needed <= *capacity)
+        return 0;
+    uint32_t grown = *capacity ? *capacity : 16;
+    while (grown < needed)
+        grown *= 2;
+    void *bigger = realloc(*array, (size_t)grown * size);
+    if (!bigger)
+        return -1;
+    *array = bigger;
+    *capacity = grown;
+    return 0;
+}
+
+// Parses directory `dir` into `index`. Deleted entries and the volume label
+// are left out; "." and ".." stay, as ls shows them.
+static int dir_index_build(DirIndex *index, uint32_t dir) {
+    const int per_cluster = bpb.SecPerClus * (bpb.BytsPerSec / sizeof(struct FAT32_DirEntry));
+    uint32_t entry_capacity = 0, name_capacity = 0, names_used = 0;
+    uint32_t slot = 0, lfn_start = 0;
+    LfnName lfn_name;
+    lfn_reset(&lfn_name);
+    memset(index, 0, sizeof(*index));
+
+    int done = 0;
+    for (uint32_t scan = dir; scan && !done; scan = get_next_cluster(scan)) {
+        if (read_dir_cluster(scan, cluster_buf) != 0)
+            goto fail;
+        struct FAT32_DirEntry *e = (struct FAT32_DirEntry *)cluster_buf;
+        for (int k = 0; k < per_cluster; k++, slot++) {
+            if (e[k].Name[0] == 0x00) { done = 1; break; }   // end of directory
+            if (e[k].Name[0] == 0xE5) { lfn_reset(&lfn_name); continue; }
+            if (e[k].Attr == 0x0F) {
+                if (e[k].Name[0] & 0x40)
+                    lfn_start = slot;
+                lfn_add(&lfn_name, (const struct FAT32_LFN_Entry *)&e[k]);
+                continue;
+            }
+            if (e[k].Attr & 0x08) { lfn_reset(&lfn_name); continue; } // volume label
+
+            char shortnm[13];
+            make_short_name_lower(e[k].Name, shortnm);
+            const char *long_name = lfn_get(&lfn_name);
+            const char *name = choose_name(long_name, shortnm);
+            uint32_t len = str_length(name) + 1;
+            if (grow_array((void **)&index->entries, &entry_capacity, index->count + 1, sizeof(DirIndexEntry))
+                    || grow_array((void **)&index->names, &name_capacity, names_used + len, 1))
+                goto fail;
+            DirIndexEntry *entry = &index->entries[index->count++];
+            memcpy(index->names + names_used, name, len);
+            entry->name = names_used;
+            entry->hash = name_hash(name);
+            entry->attr = e[k].Attr;
+            entry->lfn_slots = long_name ? (uint8_t)(slot - lfn_start) : 0;
+            memcpy(entry->short_name, e[k].Name, 11);
+            entry->slot = slot;
+            entry->cluster = ((uint32_t)e[k].FstClusHI << 16) | e[k].FstClusLO;
+            entry->size = e[k].FileSize;
+            names_used += len;
+            lfn_reset(&lfn_name);
+        }
+    }
+
+    // Buckets: a power of two at least twice the entry count
+    uint32_t buckets = 16;
+    while (buckets < index->count * 2)
+        buckets *= 2;
+    index->buckets = malloc(buckets * sizeof(uint32_t));
+    if (!index->buckets)
+        goto fail;
+    memset(index->buckets, 0xFF, buckets * sizeof(uint32_t));
+    index->bucket_mask = buckets - 1;
+    for (uint32_t i = index->count; i-- > 0;) {  // chains keep directory order
+        uint32_t b = index->entries[i].hash & index->bucket_mask;
+        index->entries[i].next = index->buckets[b];
+        index->buckets[b] = i;
+    }
+    index->dir = dir;
+    return 0;
+
+fail:
+    dir_index_release(index);
+    return -1;
+}
+
+// Parsed form of directory `dir`, building it (in the least recently used
+// slot) on a miss. NULL if the directory cannot be read or memory runs out.
+static DirIndex* dir_index_get(uint32_t dir) {
+    DirIndex *victim = &dir_indexes[0];
+    for (int i = 0; i < DIR_INDEX_SLOTS; i++) {
+        DirIndex *index = &dir_indexes[i];
+        if (index->dir == dir) {
+            index->last_used = ++dir_index_clock;
+            return index;
+        }
+        if (!index->dir || (victim->dir && index->last_used < victim->last_used))
+            victim = index;
+    }
+    dir_index_release(victim);
+    if (dir_index_build(victim, dir) < 0)
+        return NULL;
+    victim->last_used = ++dir_index_clock;
+    return victim;
+}
+
+static inline const char* dir_index_name(const DirIndex *index, uint32_t i) {
+    return index->names + index->entries[i].name;
+}
+
+// Entry called `name` (LFN or 8.3, case-insensitive) in a parsed directory
+static DirIndexEntry* dir_index_find(DirIndex *index, const char *name) {
+    uint32_t hash = name_hash(name);
+    for (uint32_t i = index->buckets[hash & index->bucket_mask]; i != DIR_INDEX_END; i = index->entries[i].next) {
+        DirIndexEntry *e = &index->entries[i];
+        if (e->hash == hash && !strcasecmp(dir_index_name(index, i), name))
+            return e;
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// Path resolution, shared by every lookup and backed by the dentry cache
+// -----------------------------------------------------------------------------
+// Looks `name` up in directory `dir` (LFN or 8.3, case-insensitive): dentry
+// cache first, then the directory's hash table. Returns 0 and fills *out if
+// found, -1 if not; both answers are remembered in the dentry cache.
+static int dir_lookup(uint32_t dir, const char *name, DentryInfo *out) {
+    if (dentry_lookup(dir, name, out))
+        return out->negative ? -1 : 0;
+    DirIndex *index = dir_index_get(dir);
+    if (!index)
+        return -1; // not cached: the name may well exist
+
+    memset(out, 0, sizeof(*out));
+    out->negative = 1;
+    const DirIndexEntry *e = dir_index_find(index, name);
+    if (e) {
+        out->negative = 0;
+        out->is_dir = (e->attr & FAT_ATTR_DIR) != 0;
+        out->cluster = e->cluster;
+        out->size = out->is_dir ? 0 : e->size;
+        out->slot = e->slot;
+        if (out->is_dir && !out->cluster)
+            out->cluster = bpb.RootClus; // ".." of a top-level directory
+    }
+    dentry_insert(dir, name, out);
+    return out->negative ? -1 : 0;
+}
+
+// Resolves `path` to what it names. Absolute paths, with or without the
+// /home prefix, start at the root directory and relative ones at `base`.
+// "." is skipped and ".." follows the parent entry (staying at the root).
+// *parent (if not NULL) gets the directory holding the entry, 0 for the root.
+static int resolve_path(const char *path, uint32_t base, DentryInfo *out, uint32_t *parent) {
+    if (path[0] == '/') {
+        base = bpb.RootClus;
+        if (str_starts_with(path, "/home/")) path += 6;
+        else if (!strcmp(path, "/home")) path += 5;
+        else path++;
+    }
+    out->negative = 0;
+    out->is_dir = 1;
+    out->cluster = base;
+    out->size = 0;
+    if (parent)
+        *parent = 0;
+
+    char segment[256];
+    int seg_i = 0;
+    for (int i = 0;; i++) {
+        char c = path[i];
+        if (c == '/' || c == '\0') {
+            segment[seg_i] = 0;
+            if (seg_i > 0 && strcmp(segment, ".")) {
+                if (!out->is_dir)
+                    return -1; // a file used as a directory
+                uint32_t dir = out->cluster;
+                int at_root = dir == bpb.RootClus;
+                if (!(at_root && !strcmp(segment, ".."))) {
+                    if (dir_lookup(dir, segment, out) < 0)
+                        return -1;
+                    if (parent)
+                        *parent = dir;
+                }
+            }
+            seg_i = 0;
+            if (c == '\0') break;
+        } else if (seg_i < (int)sizeof(segment) - 1) {
+            segment[seg_i++] = c;
+        }
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Directory updates: entries are patched in place through the write-back
+// cache, then the directory's index and dentries are dropped
+// -----------------------------------------------------------------------------
+// Sector and byte offset of entry `slot` of directory `dir`
+static int dir_slot_locate(uint32_t dir, uint32_t slot, uint64_t *lba, uint32_t *offset) {
+    uint32_t per_cluster = cluster_size / sizeof(struct FAT32_DirEntry);
+    uint32_t cluster = dir;
+    for (uint32_t n = slot / per_cluster; n && cluster; n--)
+        cluster = get_next_cluster(cluster);
+    if (!cluster)
+        return -1;
+    uint32_t byte = (slot % per_cluster) * sizeof(struct FAT32_DirEntry);
+    *lba = cluster_to_lba(cluster) + byte / bpb.BytsPerSec;
+    *offset = byte % bpb.BytsPerSec;
+    return 0;
+}
+
+// Reads entry `slot` into *entry, lets `edit` change it (NULL replaces it
+// with *entry as given) and writes the sector back
+static int dir_slot_update(uint32_t dir, uint32_t slot, struct FAT32_DirEntry *entry,
+                           void (*edit)(struct FAT32_DirEntry *, const struct FAT32_DirEntry *)) {
+    uint8_t sector[SECTOR_SIZE];
+    uint64_t lba;
+    uint32_t offset;
+    if (dir_slot_locate(dir, slot, &lba, &offset) < 0 || bcache_read(volume, lba, 1, sector) != 0)
+        return -1;
+    struct FAT32_DirEntry *on_disk = (struct FAT32_DirEntry *)(sector + offset);
+    if (edit)
+        edit(on_disk, entry);
+    else
+        memcpy(on_disk, entry, sizeof(*on_disk));
+    return bcache_write(volume, lba, 1, sector);
+}
+
+static void edit_mark_deleted(struct FAT32_DirEntry *e, const struct FAT32_DirEntry *unused) {
+    (void)unused;
+    e->Name[0] = 0xE5;
+}
+
+static void edit_set_data(struct FAT32_DirEntry *e, const struct FAT32_DirEntry *from) {
+    e->FstClusHI = from->FstClusHI;
+    e->FstClusLO = from->FstClusLO;
+    e->FileSize = from->FileSize;
+    e->WrtDate = e->LstAccDate = FAT_DEFAULT_DATE;
+}
+
+static void dir_changed(uint32_t dir) {
+    dir_index_invalidate(dir);
+    dentry_invalidate_dir(dir);
+}
+
+static int char_in(const char *set, char c) {
+    for (; *set; set++)
+        if (*set == c)
+            return 1;
+    return 0;
+}
+
+static inline char to_upper(char c) { return (c >= 'a' && c <= 'z') ? c - 32 : c; }
+
+static int short_name_char(char c) {
+    return is_alnum(c) || char_in("!#$%&'()-@^_`{}~", c) || (uint8_t)c >= 0x80;
+}
+
+// Names the long-name form may hold: no control characters, none of
+// \ / : * ? " < > |, and not made of dots and spaces only
+static int valid_long_name(const char *name) {
+    int len = str_length(name), meaningful = 0;
+    if (len == 0 || len > 255)
+        return 0;
+    for (int i = 0; i < len; i++) {
+        if ((uint8_t)name[i] < 0x20 || char_in("\\/:*?\"<>|", name[i]))
+            return 0;
+        if (name[i] != '.' && name[i] != ' ')
+            meaningful = 1;
+    }
+    return meaningful;
+}
+
+// Fills out[11] if `name` is a plain 8.3 name in one case per part, which
+// needs no LFN entries; *case_bits gets the NTRes lowercase flags
+static int fits_short_name(const char *name, uint8_t out[11], uint8_t *case_bits) {
+    const char *dot = strfindlastdot(name);
+    int base_len = dot ? (int)(dot - name) : str_length(name);
+    int ext_len = dot ? str_length(dot + 1) : 0;
+    if (base_len < 1 || base_len > 8 || ext_len > 3 || (dot && !ext_len))
+        return 0;
+    int upper[2] = { 0, 0 }, lower[2] = { 0, 0 };
+    memset(out, ' ', 11);
+    for (int i = 0; name[i]; i++) {
+        if (name + i == dot)
+            continue;
+        int part = dot && name + i > dot;
+        char c = name[i];
+        if (!short_name_char(c))
+            return 0;
+        if (c >= 'a' && c <= 'z') lower[part] = 1;
+        if (c >= 'A' && c <= 'Z') upper[part] = 1;
+        out[part ? 8 + (name + i - dot - 1) : i] = to_upper(c);
+    }
+    if ((upper[0] && lower[0]) || (upper[1] && lower[1]))
+        return 0;
+    *case_bits = (lower[0] ? 0x08 : 0) | (lower[1] ? 0x10 : 0);
+    return 1;
+}
+
+// Numeric-tail alias (BASE~N.EXT) for a long name, unique among the short
+// names of `index`
+static int make_alias(const char *name, const DirIndex *index, uint8_t out[11]) {
+    char base[9], ext[4];
+    int b = 0, x = 0;
+    const char *dot = strfindlastdot(name);
+    for (const char *p = name; *p && (!dot || p < dot) && b < 8; p++)
+        if (*p != ' ' && *p != '.')
+            base[b++] = short_name_char(*p) ? to_upper(*p) : '_';
+    for (const char *p = dot ? dot + 1 : ""; *p && x < 3; p++)
+        if (*p != ' ' && *p != '.')
+            ext[x++] = short_name_char(*p) ? to_upper(*p) : '_';
+    if (!b)
+        base[b++] = '_';
+
+    for (uint32_t n = 1; n < 1000000; n++) {
+        char tail[8];
+        int t = 0;
+        for (uint32_t v = n; v; v /= 10)
+            tail[t++] = '0' + v % 10;
+        int keep = b < 7 - t ? b : 7 - t;
+        memset(out, ' ', 11);
+        memcpy(out, base, keep);
+        out[keep] = '~';
+        for (int i = 0; i < t; i++)
+            out[keep + 1 + i] = tail[t - 1 - i];
+        memcpy(out + 8, ext, x);
+        uint32_t i = 0;
+        for (; i < index->count; i++) {
+            int k = 0;
+            while (k < 11 && index->entries[i].short_name[k] == out[k])
+                k++;
+            if (k == 11)
+                break;
+        }
+        if (i == index->count)
+            return 0;
+    }
+    return -1;
+}
+
+static uint8_t short_name_checksum(const uint8_t name[11]) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; i++)
+        sum = (uint8_t)(((sum & 1) << 7) + (sum >> 1) + name[i]);
+    return sum;
+}
+
+// LFN entry `seq` (1-based) of `name`: 13 characters, then a terminator and
+// 0xFFFF padding in the last one
+static void lfn_fill(struct FAT32_LFN_Entry *lfn, const char *name, int seq, int last, uint8_t checksum) {
+    uint8_t *raw = (uint8_t *)lfn;
+    int len = str_length(name);
+    memset(raw, 0, sizeof(*lfn));
+    lfn->Ord = (uint8_t)(seq | (last ? 0x40 : 0));
+    lfn->Attr = 0x0F;
+    lfn->Checksum = checksum;
+    for (int i = 0; i < 13; i++) {
+        int pos = (seq - 1) * 13 + i;
+        uint16_t c = pos < len ? (uint8_t)name[pos] : pos == len ? 0 : 0xFFFF;
+        raw[lfn_char_offsets[i]] = (uint8_t)c;
+        raw[lfn_char_offsets[i] + 1] = (uint8_t)(c >> 8);
+    }
+}
+
+static int zero_cluster(uint32_t cluster) {
+    static const uint8_t zeros[SECTOR_SIZE];
+    uint64_t lba = cluster_to_lba(cluster);
+    for (uint32_t s = 0; s < bpb.SecPerClus; s++)
+        if (bcache_write(volume, lba + s, 1, zeros) != 0)
+            return -1;
+    return 0;
+}
+
+// First of `count` consecutive free slots in `dir`; a full directory grows
+// by zeroed clusters. Returns 0, -1 on a read error or -2 if the volume is full.
+static int dir_find_free(uint32_t dir, uint32_t count, uint32_t *first) {
+    const uint32_t per_cluster = cluster_size / sizeof(struct FAT32_DirEntry);
+    uint32_t slot = 0, run = 0, last = dir;
+    for (uint32_t c = dir, i = 0; c && i < total_clusters; c = get_next_cluster(c), i++) {
+        last = c;
+        if (read_dir_cluster(c, cluster_buf) != 0)
+            return -1;
+        struct FAT32_DirEntry *e = (struct FAT32_DirEntry *)cluster_buf;
+        for (uint32_t k = 0; k < per_cluster; k++, slot++) {
+            if (e[k].Name[0] != 0x00 && e[k].Name[0] != 0xE5) {
+                run = 0;
+                continue;
+            }
+            if (!run++)
+                *first = slot;
+            if (run == count)
+                return 0;
+        }
+    }
+    while (run < count) {
+        uint32_t c = alloc_cluster(last);
+        if (!c)
+            return -2;
+        if (zero_cluster(c) != 0)
+            return -1;
+        if (!run)
+            *first = slot;
+        run += per_cluster;
+        slot += per_cluster;
+        last = c;
+    }
+    return 0;
+}
+
+// Adds `name` to `dir`: a short entry, after LFN entries unless the name
+// is a plain 8.3 one. Returns 0, -1 on error or -2 if the volume is full.
+static int dir_add_entry(uint32_t dir, const char *name, uint8_t attr, uint32_t cluster, uint32_t size) {
+    struct FAT32_DirEntry entry;
+    uint8_t case_bits = 0;
+    int lfn_slots = 0;
+    memset(&entry, 0, sizeof(entry));
+    if (!fits_short_name(name, entry.Name, &case_bits)) {
+        DirIndex *index = dir_index_get(dir);
+        if (!index || make_alias(name, index, entry.Name) < 0)
+            return -1;
+        lfn_slots = (str_length(name) + 12) / 13;
+    }
+    entry.Attr = attr;
+    entry.NTRes = case_bits;
+    entry.CrtDate = entry.WrtDate = entry.LstAccDate = FAT_DEFAULT_DATE;
+    entry.FstClusHI = (uint16_t)(cluster >> 16);
+    entry.FstClusLO = (uint16_t)cluster;
+    entry.FileSize = size;
+
+    uint32_t first = 0;
+    int result = dir_find_free(dir, lfn_slots + 1, &first);
+    if (result < 0)
+        return result;
+    uint8_t checksum = short_name_checksum(entry.Name);
+    for (int i = 0; i < lfn_slots && !result; i++) {
+        struct FAT32_DirEntry raw;
+        lfn_fill((struct FAT32_LFN_Entry *)&raw, name, lfn_slots - i, i == 0, checksum);
+        result = dir_slot_update(dir, first + i, &raw, NULL);
+    }
+    if (!result)
+        result = dir_slot_update(dir, first + lfn_slots, &entry, NULL);
+    dir_changed(dir);
+    return result;
+}
+
+// Marks the entry and its LFN entries deleted
+static int dir_remove_entry(uint32_t dir, uint32_t slot, uint32_t lfn_slots) {
+    int result = 0;
+    for (uint32_t s = slot - lfn_slots; s <= slot && !result; s++)
+        result = dir_slot_update(dir, s, NULL, edit_mark_deleted);
+    dir_changed(dir);
+    return result;
+}
+
+// Points the entry at a new first cluster and size
+static int dir_update_entry(uint32_t dir, DirIndexEntry *e, uint32_t cluster, uint32_t size) {
+    struct FAT32_DirEntry data;
+    data.FstClusHI = (uint16_t)(cluster >> 16);
+    data.FstClusLO = (uint16_t)cluster;
+    data.FileSize = size;
+    if (dir_slot_update(dir, e->slot, &data, edit_set_data) != 0)
+        return -1;
+    e->cluster = cluster;  // the index stays valid; cached dentries may not
+    e->size = size;
+    dentry_invalidate_dir(dir);
+    return 0;
+}
+
+// Resolves everything but the last component of `path` (relative paths
+// start at the current directory) and copies that component to leaf[256]
+static int resolve_parent(const char *path, uint32_t *dir, char *leaf) {
+    char parent[MAX_PATH_LEN];
+    const char *slash = NULL;
+    for (const char *p = path; *p; p++)
+        if (*p == '/')
+            slash = p;
+    const char *name = slash ? slash + 1 : path;
+    uint32_t len = slash ? (uint32_t)(slash - path) : 0;
+    if (len >= sizeof(parent) || str_length(name) > 255)
+        return -1;
+    memcpy(parent, path, len);
+    parent[len] = 0;
+    if (slash == path)
+        str_copy(parent, "/", sizeof(parent));
+
+    DentryInfo info;
+    if (resolve_path(parent, current_dir_cluster, &info, NULL) < 0 || !info.is_dir)
+        return -1;
+    *dir = info.cluster;
+    str_copy(leaf, name, 256);
+    return valid_long_name(leaf) ? 0 : -1;
+}
+
 // -----------------------------------------------------------------------------
 // MBR partition search (unchanged)
 // -----------------------------------------------------------------------------
@@ -109,9 +1101,9 @@ struct __attribute__((packed)) PartitionEntry {
     uint32_t total_sectors;
 };
 
-uint32_t find_fat32_partition() {
+uint32_t find_fat32_partition(BlockDevice *dev) {
     uint8_t mbr[512];
-    if (ata_read_sector(0, mbr) != 0) return 0;
+    if (block_read(dev, 0, 1, mbr) != 0) return 0;
     struct PartitionEntry *entries = (struct PartitionEntry *)(mbr + 446);
     for (int i = 0; i < 4; i++)
         if (entries[i].partition_type == 0x0B || entries[i].partition_type == 0x0C)
@@ -122,75 +1114,49 @@ uint32_t find_fat32_partition() {
 // -----------------------------------------------------------------------------
 // Init
 // -----------------------------------------------------------------------------
-int fat32_init(uint32_t partition_lba_start) {
+int fat32_init(BlockDevice *dev, uint32_t partition_lba_start) {
     uint8_t sector[512];
-    if (ata_read_sector(partition_lba_start, sector) != 0) return -1;
-
+    if (!dev || dev->block_size != 512) return -1;
+    if (block_read(dev, partition_lba_start, 1, sector) != 0) return -1;
+
+    struct FAT32_BPB *candidate = (struct FAT32_BPB *)sector;
+    if (candidate->BytsPerSec != 512 || candidate->SecPerClus == 0 || candidate->SecPerClus > 64
+            || candidate->NumFATs == 0 || candidate->FATSz32 == 0) return -1;
+    if (volume)
+        fat32_sync();  // nothing of the previous volume may stay dirty
     memcpy(&bpb, sector, sizeof(struct FAT32_BPB));
-    if (bpb.BytsPerSec != 512 || bpb.SecPerClus == 0 || bpb.NumFATs == 0) return -1;
+    volume = dev;
 
+    partition_lba      = partition_lba_start;
     fat_begin_lba      = partition_lba_start + bpb.RsvdSecCnt;
     first_data_sector  = partition_lba_start + bpb.RsvdSecCnt + (bpb.NumFATs * bpb.FATSz32);
     cluster_size       = bpb.SecPerClus * bpb.BytsPerSec;
     current_dir_cluster = bpb.RootClus;
     str_copy(current_dir_path, "/home", MAX_PATH_LEN);
+    total_clusters     = (bpb.TotSec32 - (first_data_sector - partition_lba_start)) / bpb.SecPerClus;
+    fat_cache_load();
+    if (total_clusters > fat_entries - 2)
+        total_clusters = fat_entries - 2;
+    fsinfo_load();
+    free_counted = 0;
+    if (fat_table)
+        free_map_build();  // no I/O: the FAT is already in memory
+    else {
+        free(free_map);    // built on first allocation, or by a usage query
+        free_map = NULL;   // when FSInfo has no count
+    }
+    dentry_flush();
+    dir_index_invalidate(0);
     return 0;
 }
 
 int fat32_get_entry_name(uint32_t dir_cluster, int index, char *out, size_t out_size) {
-    uint32_t cluster = dir_cluster;
-    uint8_t sector_buf[512];
-    int eps = bpb.BytsPerSec / sizeof(struct FAT32_DirEntry);
-    int total = 0;
-    char lfn_buf[256]; 
-    lfn_buf[0] = 0;
-
-    while (cluster != 0) {
-        uint32_t lba = cluster_to_lba(cluster);
-
-        for (int s = 0; s < bpb.SecPerClus; s++) {
-            ata_read_sector(lba + s, sector_buf);
-            struct FAT32_DirEntry *e = (struct FAT32_DirEntry *)sector_buf;
-
-            for (int i = 0; i < eps; i++) {
-                if (e[i].Name[0] == 0x00) {
-                    // End of directory
-                    return 0;
-                }
-                if (e[i].Name[0] == 0xE5) {
-                    // Deleted entry
-                    lfn_buf[0] = 0;
-                    continue;
-                }
-
-                if (e[i].Attr == 0x0F) {
-                    // Long file name (LFN) entry
-                    const struct FAT32_LFN_Entry *lfn = (const struct FAT32_LFN_Entry *)&e[i];
-                    lfn_prepend_piece(lfn_buf, lfn, sizeof(lfn_buf));
-                    continue;
-                }
-
-                // Normal entry
-                if (total == index) {
-                    // Construct proper name
-                    char shortnm[13];
-                    make_short_name_lower(e[i].Name, shortnm);
-                    const char *disp = choose_name(lfn_buf, shortnm);
-
-                    strncpy(out, disp, out_size - 1);
-                    out[out_size - 1] = '\0';
-                    return 1;
-                }
-
-                total++;
-                lfn_buf[0] = 0; // reset LFN for next entry
-            }
-        }
-
-        cluster = get_next_cluster(cluster);
-    }
-
-    return 0;
+    DirIndex *dir = dir_index_get(dir_cluster);
+    if (!dir || index < 0 || (uint32_t)index >= dir->count)
+        return 0;
+    strncpy(out, dir_index_name(dir, index), out_size - 1);
+    out[out_size - 1] = '\0';
+    return 1;
 }
 
 
@@ -198,43 +1164,9 @@ int fat32_get_entry_name(uint32_t dir_cluster, int index, char *out, size_t out_
 // ls with LFN support
 // -----------------------------------------------------------------------------
 int fat32_ls(Window* win, uint32_t dir_cluster, int selected_index, int max_entries) {
-    uint32_t cluster = dir_cluster;
-    uint8_t sector_buf[512];
-    int eps = bpb.BytsPerSec / sizeof(struct FAT32_DirEntry);
-
-    // Gather directory entries
-    struct FAT32_DirEntry entries[512]; // up to 512 entries per dir
-    char lfns[512][256];
-    int total = 0;
-
-    while (cluster != 0 && total < 512) {
-        uint32_t lba = cluster_to_lba(cluster);
-        for (int s = 0; s < bpb.SecPerClus && total < 512; s++) {
-            ata_read_sector(lba + s, sector_buf);
-            struct FAT32_DirEntry *e = (struct FAT32_DirEntry *)sector_buf;
-            char lfn_buf[256]; lfn_buf[0] = 0;
-
-            for (int i = 0; i < eps && total < 512; i++) {
-                if (e[i].Name[0] == 0x00) goto entries_done;
-                if (e[i].Name[0] == 0xE5) { lfn_buf[0] = 0; continue; }
-
-                if (e[i].Attr == 0x0F) {
-                    const struct FAT32_LFN_Entry *lfn = (const struct FAT32_LFN_Entry *)&e[i];
-                    lfn_prepend_piece(lfn_buf, lfn, sizeof(lfn_buf));
-                    continue;
-                }
-
-                entries[total] = e[i];
-                strncpy(lfns[total], lfn_buf, sizeof(lfns[0]));
-                lfns[total][sizeof(lfns[0]) - 1] = 0;
-                total++;
-                lfn_buf[0] = 0;
-            }
-        }
-        cluster = get_next_cluster(cluster);
-    }
-
-entries_done:
+    // Parsed once per directory, so moving the selection re-reads nothing
+    DirIndex *dir = dir_index_get(dir_cluster);
+    int total = dir ? (int)dir->count : 0;
     if (total == 0) return -1;  // No entries found
 
     // Clamp selected index
@@ -252,9 +1184,8 @@ entries_done:
 
     // Display entries
     for (int i = start; i < end; i++) {
-        const struct FAT32_DirEntry *e = &entries[i];
-        char shortnm[13]; make_short_name_lower(e->Name, shortnm);
-        const char *disp = choose_name(lfns[i], shortnm);
+        const DirIndexEntry *e = &dir->entries[i];
+        const char *disp = dir_index_name(dir, i);
 
         // Highlight selected entry
         if (i == selected_index) 
@@ -262,11 +1193,11 @@ entries_done:
 
         //if (e->Attr & 0x10) fb_write_ansi(win, "\033[33m"); // directory = yellow
         fb_write(win, disp);
-        if (e->Attr & 0x10) fb_write_ansi(win, " \033[36mdir\033[0m");
+        if (e->attr & 0x10) fb_write_ansi(win, " \033[36mdir\033[0m");
         else {
             fb_write(win, " ");
             fb_write_ansi(win, "\033[36m");
-            fb_write_dec(win, e->FileSize);
+            fb_write_dec(win, e->size);
             fb_write_ansi(win, " bytes\033[0m");
         }
 
@@ -317,24 +1248,9 @@ void fat32_cd(Window *win, const char *path) {
                     // back one level; never go above /home and no trailing slash
                     if (current_dir_cluster != bpb.RootClus) {
                         // cluster: follow ".." entry
-                        uint8_t sb[512]; int eps = bpb.BytsPerSec / sizeof(struct FAT32_DirEntry);
-                        uint32_t temp = current_dir_cluster; int found = 0;
-                        while (temp && !found) {
-                            uint32_t lba = cluster_to_lba(temp);
-                            for (int s = 0; s < bpb.SecPerClus && !found; s++) {
-                                ata_read_sector(lba + s, sb);
-                                struct FAT32_DirEntry *de = (struct FAT32_DirEntry *)sb;
-                                for (int k = 0; k < eps; k++) {
-                                    if (de[k].Name[0] == 0x00) break;
-                                    if (de[k].Attr == 0x0F) continue;
-                                    if (de[k].Name[0] == '.' && de[k].Name[1] == '.') {
-                                        current_dir_cluster = (de[k].FstClusHI << 16) | de[k].FstClusLO;
-                                        found = 1; break;
-                                    }
-                                }
-                            }
-                            if (!found) temp = get_next_cluster(temp);
-                        }
+                        DentryInfo parent;
+                        if (dir_lookup(current_dir_cluster, "..", &parent) == 0)
+                            current_dir_cluster = parent.cluster;
                         // Trim current_dir_path back one component
                         int len = str_length(current_dir_path);
                         if (len > 1 && current_dir_path[len - 1] == '/') len--;
@@ -345,43 +1261,10 @@ void fat32_cd(Window *win, const char *path) {
                     }
                 } else {
                     // descend into a subdir by matching LFN or 8.3
-                    uint8_t sb[512]; int eps = bpb.BytsPerSec / sizeof(struct FAT32_DirEntry);
+                    DentryInfo info;
                     uint32_t found_cluster = 0;
-                    uint32_t scan = current_dir_cluster;
-                    while (scan && !found_cluster) {
-                        uint32_t lba = cluster_to_lba(scan);
-                        for (int s = 0; s < bpb.SecPerClus && !found_cluster; s++) {
-                            ata_read_sector(lba + s, sb);
-                            struct FAT32_DirEntry *e = (struct FAT32_DirEntry *)sb;
-
-                            char lfn_buf[256]; lfn_buf[0] = 0;
-                            for (int k = 0; k < eps; k++) {
-                                if (e[k].Name[0] == 0x00) break;
-                                if (e[k].Name[0] == 0xE5) { lfn_buf[0] = 0; continue; }
-
-                                if (e[k].Attr == 0x0F) {
-                                    const struct FAT32_LFN_Entry *lfn = (const struct FAT32_LFN_Entry *)&e[k];
-                                    lfn_prepend_piece(lfn_buf, lfn, sizeof(lfn_buf));
-                                    continue;
-                                }
-
-                                // Regular entry
-                                if (!(e[k].Attr & 0x10)) { lfn_buf[0] = 0; continue; } // only dirs
-
-                                char shortnm[13]; make_short_name_lower(e[k].Name, shortnm);
-                                const char *cand = choose_name(lfn_buf, shortnm);
-
-                                // Lowercase compare (segment assumed ASCII)
-                                int match = !strcasecmp(cand, segment);
-                                if (match) {
-                                    found_cluster = (e[k].FstClusHI << 16) | e[k].FstClusLO;
-                                    break;
-                                }
-                                lfn_buf[0] = 0;
-                            }
-                        }
-                        if (!found_cluster) scan = get_next_cluster(scan);
-                    }
+                    if (dir_lookup(current_dir_cluster, segment, &info) == 0 && info.is_dir)
+                        found_cluster = info.cluster;
 
                     if (!found_cluster) {
                         fb_write_ansi(win, "\n\033[31m  ERROR\033[0m No such directory: ");
@@ -411,7 +1294,6 @@ void fat32_cd(Window *win, const char *path) {
 // -----------------------------------------------------------------------------
 void fat32_cat(Window* win, const char *filename) {
     uint32_t cluster = current_dir_cluster;
-    uint8_t sector_buf[512];
     int eps = bpb.BytsPerSec / sizeof(struct FAT32_DirEntry);
 
     // Detect if the file has an extension
@@ -419,12 +1301,12 @@ void fat32_cat(Window* win, const char *filename) {
     int has_extension = (dot && *(dot + 1) != 0);
 
     while (cluster != 0) {
-        uint32_t lba = cluster_to_lba(cluster);
+        read_dir_cluster(cluster, cluster_buf);
         for (int s = 0; s < bpb.SecPerClus; s++) {
-            ata_read_sector(lba + s, sector_buf);
+            uint8_t *sector_buf = cluster_buf + s * bpb.BytsPerSec;
             struct FAT32_DirEntry *e = (struct FAT32_DirEntry *)sector_buf;
 
-            char lfn_buf[256]; lfn_buf[0] = 0;
+            LfnName lfn_name; lfn_reset(&lfn_name);
             for (int i = 0; i < eps; i++) {
                 if (e[i].Name[0] == 0x00) {
                     fb_write_ansi(win, "\n\033[31m  ERROR\033[0m No such file: ");
@@ -432,26 +1314,26 @@ void fat32_cat(Window* win, const char *filename) {
                     fb_write(win, "\n");
                     return;
                 }
-                if (e[i].Name[0] == 0xE5) { lfn_buf[0] = 0; continue; }
+                if (e[i].Name[0] == 0xE5) { lfn_reset(&lfn_name); continue; }
                 if (e[i].Attr == 0x0F) {
                     const struct FAT32_LFN_Entry *lfn = (const struct FAT32_LFN_Entry *)&e[i];
-                    lfn_prepend_piece(lfn_buf, lfn, sizeof(lfn_buf));
+                    lfn_add(&lfn_name, lfn);
                     continue;
                 }
                 // Regular
                 char shortnm[13]; make_short_name_lower(e[i].Name, shortnm);
-                const char *cand = choose_name(lfn_buf, shortnm);
+                const char *cand = choose_name(lfn_get(&lfn_name), shortnm);
                 if (!strcasecmp(cand, filename) && !(e[i].Attr & 0x10)) {
                     uint32_t fclus = (e[i].FstClusHI << 16) | e[i].FstClusLO;
                     uint32_t size  = e[i].FileSize;
                     uint32_t bytes_read = 0;
                     while (fclus && bytes_read < size && bytes_read < BUFFER_SIZE) {
-                        uint32_t sec_lba = cluster_to_lba(fclus);
-                        for (int s2 = 0; s2 < bpb.SecPerClus; s2++) {
-                            ata_read_sector(sec_lba + s2, file_buffer + bytes_read);
-                            bytes_read += bpb.BytsPerSec;
-                            if (bytes_read >= size || bytes_read >= BUFFER_SIZE) break;
-                        }
+                        // Only the sectors still needed, in one command
+                        uint32_t limit = size < BUFFER_SIZE ? size : BUFFER_SIZE;
+                        uint32_t sectors = (limit - bytes_read + bpb.BytsPerSec - 1) / bpb.BytsPerSec;
+                        if (sectors > bpb.SecPerClus) sectors = bpb.SecPerClus;
+                        disk_read(cluster_to_lba(fclus), sectors, file_buffer + bytes_read);
+                        bytes_read += sectors * bpb.BytsPerSec;
                         fclus = get_next_cluster(fclus);
                     }
 
@@ -537,7 +1419,7 @@ void fat32_cat(Window* win, const char *filename) {
                     return;
                 }
 
-                lfn_buf[0] = 0;
+                lfn_reset(&lfn_name);
             }
         }
         cluster = get_next_cluster(cluster);
@@ -551,21 +1433,14 @@ void fat32_cat(Window* win, const char *filename) {
 // Usage
 // -----------------------------------------------------------------------------
 struct FAT32_Usage fat32_get_usage(void) {
-    uint8_t sector[512];
-    uint32_t free_clusters = 0;
-    for (uint32_t s = 0; s < bpb.FATSz32; s++) {
-        if (ata_read_sector(fat_begin_lba + s, sector) != 0) break;
-        uint32_t *entry = (uint32_t *)sector;
-        for (uint32_t i = 0; i < bpb.BytsPerSec / 4; i++)
-            if ((*entry++ & 0x0FFFFFFF) == 0) free_clusters++;
-    }
-    uint32_t data_sectors   = bpb.TotSec32 - (bpb.RsvdSecCnt + (bpb.NumFATs * bpb.FATSz32));
-    uint32_t total_clusters = bpb.SecPerClus ? data_sectors / bpb.SecPerClus : 0;
-    uint32_t cluster_bytes  = bpb.SecPerClus * bpb.BytsPerSec;
-    uint64_t total_bytes = (uint64_t)total_clusters * cluster_bytes;
-    uint64_t free_bytes  = (uint64_t)free_clusters * cluster_bytes;
+    struct FAT32_Usage u = { 0, 0 };
+    if (!volume)
+        return u;
+    if (free_count == FSINFO_UNKNOWN)
+        free_map_build();
+    uint64_t total_bytes = (uint64_t)total_clusters * cluster_size;
+    uint64_t free_bytes  = free_count == FSINFO_UNKNOWN ? 0 : (uint64_t)free_count * cluster_size;
     uint64_t used_bytes  = (total_bytes >= free_bytes) ? total_bytes - free_bytes : 0;
-    struct FAT32_Usage u;
     u.total_mb = (uint32_t)(total_bytes / (1024ULL * 1024ULL));
     u.used_mb  = (uint32_t)(used_bytes  / (1024ULL * 1024ULL));
     return u;
@@ -575,6 +1450,7 @@ struct FAT32_Usage fat32_get_usage(void) {
 // Accessors
 // -----------------------------------------------------------------------------
 uint32_t fat32_get_current_dir(void) { return current_dir_cluster; }
+BlockDevice* fat32_get_device(void) { return volume; }
 void     fat32_set_current_dir(uint32_t cluster) { current_dir_cluster = cluster; }
 
 
@@ -582,130 +1458,47 @@ size_t fat32_read(char* buf, size_t bufsize, size_t start_page, const char* path
     if (!path || !path[0])
         return 0;
 
-    uint32_t cluster;
-    char segment[64];
-    int seg_i = 0;
-    int reading_file = 0;
-
-    // --- Determine starting cluster ---
-    if (path[0] == '/') {
-        // Absolute path — reset to root
-        cluster = bpb.RootClus;
-        // Strip "/home/" if present
-        if (str_starts_with(path, "/home/"))
-            path += 6;
-        else if (!strcmp(path, "/home") || !strcmp(path, "/"))
-            path = "";
-        else
-            path++;
-    } else {
-        // Relative path — use current directory
-        cluster = current_dir_cluster;
-    }
-
-    // ---- Parse and resolve path ----
-    for (int i = 0;; i++) {
-        char c = path[i];
-        if (c == '/' || c == '\0') {
-            segment[seg_i] = 0;
-            if (seg_i > 0) {
-                // Skip . and ..
-                if (!strcmp(segment, ".")) {
-                    seg_i = 0;
-                    if (c == '\0') break;
-                    continue;
-                } else if (!strcmp(segment, "..")) {
-                    // TODO: handle parent traversal if you store parent clusters
-                    seg_i = 0;
-                    if (c == '\0') break;
-                    continue;
-                }
-
-                // Search this segment in current cluster
-                uint8_t sb[512];
-                int eps = bpb.BytsPerSec / sizeof(struct FAT32_DirEntry);
-                uint32_t found_cluster = 0;
-                uint32_t scan = cluster;
-
-                while (scan && !found_cluster) {
-                    uint32_t lba = cluster_to_lba(scan);
-                    for (int s = 0; s < bpb.SecPerClus && !found_cluster; s++) {
-                        ata_read_sector(lba + s, sb);
-                        struct FAT32_DirEntry* e = (struct FAT32_DirEntry*)sb;
-                        char lfn_buf[256]; lfn_buf[0] = 0;
-
-                        for (int k = 0; k < eps; k++) {
-                            if (e[k].Name[0] == 0x00) break;
-                            if (e[k].Name[0] == 0xE5) { lfn_buf[0] = 0; continue; }
-                            if (e[k].Attr == 0x0F) {
-                                const struct FAT32_LFN_Entry* lfn = (const struct FAT32_LFN_Entry*)&e[k];
-                                lfn_prepend_piece(lfn_buf, lfn, sizeof(lfn_buf));
-                                continue;
-                            }
-
-                            char shortnm[13];
-                            make_short_name_lower(e[k].Name, shortnm);
-                            const char* cand = choose_name(lfn_buf, shortnm);
-
-                            if (!strcasecmp(cand, segment)) {
-                                found_cluster = (e[k].FstClusHI << 16) | e[k].FstClusLO;
-                                reading_file = !(e[k].Attr & 0x10);
-                                break;
-                            }
-                            lfn_buf[0] = 0;
-                        }
-                    }
-                    if (!found_cluster)
-                        scan = get_next_cluster(scan);
-                }
-
-                if (!found_cluster)
-                    return 0; // not found
-                cluster = found_cluster;
-            }
-
-            seg_i = 0;
-            if (c == '\0')
-                break;
-        } else if (seg_i < (int)sizeof(segment) - 1) {
-            segment[seg_i++] = c;
-        }
-    }
+    DentryInfo info;
+    if (resolve_path(path, current_dir_cluster, &info, NULL) < 0)
+        return 0; // not found
+    uint32_t cluster = info.cluster;
+    int reading_file = !info.is_dir;
+    if (!cluster)
+        return 0; // empty file
 
     // ---- Read content ----
     if (!reading_file) {
         // Directory listing — dump entries into buf
-        uint8_t sector_buf[512];
         int eps = bpb.BytsPerSec / sizeof(struct FAT32_DirEntry);
         size_t pos = 0, page = 0;
 
         while (cluster) {
-            uint32_t lba = cluster_to_lba(cluster);
+            read_dir_cluster(cluster, cluster_buf);
             for (int s = 0; s < bpb.SecPerClus; s++) {
                 if (page++ < start_page) continue;
-                ata_read_sector(lba + s, sector_buf);
+                uint8_t *sector_buf = cluster_buf + s * bpb.BytsPerSec;
                 struct FAT32_DirEntry* e = (struct FAT32_DirEntry*)sector_buf;
-                char lfn_buf[256]; lfn_buf[0] = 0;
+                LfnName lfn_name; lfn_reset(&lfn_name);
 
                 for (int i = 0; i < eps; i++) {
                     if (e[i].Name[0] == 0x00) { buf[pos] = 0; return pos; }
-                    if (e[i].Name[0] == 0xE5) { lfn_buf[0] = 0; continue; }
+                    if (e[i].Name[0] == 0xE5) { lfn_reset(&lfn_name); continue; }
                     if (e[i].Attr == 0x0F) {
                         const struct FAT32_LFN_Entry* lfn = (const struct FAT32_LFN_Entry*)&e[i];
-                        lfn_prepend_piece(lfn_buf, lfn, sizeof(lfn_buf));
+                        lfn_add(&lfn_name, lfn);
                         continue;
                     }
 
                     char shortnm[13];
                     make_short_name_lower(e[i].Name, shortnm);
-                    const char* name = choose_name(lfn_buf, shortnm);
+                    const char* name = choose_name(lfn_get(&lfn_name), shortnm);
                     for (int j = 0; name[j]; j++) {
                         if (pos >= bufsize - 2) return 0;
                         buf[pos++] = name[j];
                     }
                     buf[pos++] = '\n';
                     if (pos >= bufsize - 1) return 0;
-                    lfn_buf[0] = 0;
+                    lfn_reset(&lfn_name);
                 }
             }
             cluster = get_next_cluster(cluster);
@@ -717,40 +1510,34 @@ size_t fat32_read(char* buf, size_t bufsize, size_t start_page, const char* path
         // Reading file
         uint32_t fclus = cluster;
         uint32_t bytes_read = 0;
-        uint32_t file_size = 0;
-
-        // Find file size by scanning current directory
-        uint8_t sb[512];
-        uint32_t scan = current_dir_cluster;
-        while (scan && !file_size) {
-            uint32_t lba = cluster_to_lba(scan);
-            for (int s = 0; s < bpb.SecPerClus && !file_size; s++) {
-                ata_read_sector(lba + s, sb);
-                struct FAT32_DirEntry* e = (struct FAT32_DirEntry*)sb;
-                int eps = bpb.BytsPerSec / sizeof(struct FAT32_DirEntry);
-                for (int k = 0; k < eps; k++) {
-                    if (e[k].Name[0] == 0x00) break;
-                    if (e[k].Attr == 0x0F) continue;
-                    uint32_t clus = (e[k].FstClusHI << 16) | e[k].FstClusLO;
-                    if (clus == cluster) {
-                        file_size = e[k].FileSize;
-                        break;
-                    }
-                }
-            }
-            scan = get_next_cluster(scan);
-        }
+        uint32_t file_size = info.size;
 
         if (file_size + 1 > bufsize)
             return 0;
 
         while (fclus && bytes_read < file_size) {
-            uint32_t sec_lba = cluster_to_lba(fclus);
-            for (int s = 0; s < bpb.SecPerClus && bytes_read < file_size; s++) {
-                ata_read_sector(sec_lba + s, (uint8_t*)buf + bytes_read);
-                bytes_read += 512;
+            // Consecutive clusters make one request; whole sectors go straight
+            // into buf and a partial tail goes through a bounce sector, so buf
+            // is never written past file_size
+            uint32_t remaining = file_size - bytes_read;
+            uint32_t first = fclus, run = 1;
+            fclus = get_next_cluster(first);
+            while (fclus == first + run && (uint64_t)run * cluster_size < remaining) {
+                run++;
+                fclus = get_next_cluster(fclus);
+            }
+            uint64_t span = (uint64_t)run * cluster_size;
+            uint32_t sectors = (span < remaining ? span : remaining) / bpb.BytsPerSec;
+            if (sectors) {
+                disk_read(cluster_to_lba(first), sectors, (uint8_t*)buf + bytes_read);
+                bytes_read += sectors * bpb.BytsPerSec;
+            }
+            if (span > remaining && bytes_read < file_size) {
+                uint8_t tail[512];
+                disk_read(cluster_to_lba(first) + sectors, 1, tail);
+                memcpy((uint8_t*)buf + bytes_read, tail, file_size - bytes_read);
+                bytes_read = file_size;
             }
-            fclus = get_next_cluster(fclus);
         }
 
         buf[file_size] = 0;
@@ -763,255 +1550,373 @@ size_t fat32_read(char* buf, size_t bufsize, size_t start_page, const char* path
 // Retrieve file size by path (returns 0 if not found or it's a directory)
 // -----------------------------------------------------------------------------
 size_t fat32_get_file_size(const char *path) {
-    if (!path || !path[0])
+    DentryInfo info;
+    if (!path || !path[0] || resolve_path(path, bpb.RootClus, &info, NULL) < 0 || info.is_dir)
         return 0;
+    return info.size;
+}
 
-    uint32_t cluster = bpb.RootClus;
-    char segment[64];
-    int seg_i = 0;
-    int is_file = 0;
-    uint32_t file_size = 0;
-
-    // Normalize base path
-    if (!strcmp(path, "/home") || !strcmp(path, "/"))
-        cluster = bpb.RootClus;
-    else if (str_starts_with(path, "/home/"))
-        path += 6;
-    else if (path[0] == '/')
-        path++;
-
-    // ---- Walk the path ----
-    for (int i = 0;; i++) {
-        char c = path[i];
-        if (c == '/' || c == '\0') {
-            segment[seg_i] = 0;
-            if (seg_i > 0) {
-                uint8_t sb[512];
-                int eps = bpb.BytsPerSec / sizeof(struct FAT32_DirEntry);
-                uint32_t found_cluster = 0;
-                uint32_t scan = cluster;
-
-                while (scan && !found_cluster) {
-                    uint32_t lba = cluster_to_lba(scan);
-                    for (int s = 0; s < bpb.SecPerClus && !found_cluster; s++) {
-                        ata_read_sector(lba + s, sb);
-                        struct FAT32_DirEntry *e = (struct FAT32_DirEntry *)sb;
-                        char lfn_buf[256]; lfn_buf[0] = 0;
-
-                        for (int k = 0; k < eps; k++) {
-                            if (e[k].Name[0] == 0x00) break;
-                            if (e[k].Name[0] == 0xE5) { lfn_buf[0] = 0; continue; }
-                            if (e[k].Attr == 0x0F) {
-                                const struct FAT32_LFN_Entry *lfn = (const struct FAT32_LFN_Entry *)&e[k];
-                                lfn_prepend_piece(lfn_buf, lfn, sizeof(lfn_buf));
-                                continue;
-                            }
-
-                            char shortnm[13]; make_short_name_lower(e[k].Name, shortnm);
-                            const char *cand = choose_name(lfn_buf, shortnm);
-
-                            if (!strcasecmp(cand, segment)) {
-                                found_cluster = (e[k].FstClusHI << 16) | e[k].FstClusLO;
-                                is_file = !(e[k].Attr & 0x10);
-                                if (is_file)
-                                    file_size = e[k].FileSize;
-                                break;
-                            }
-                            lfn_buf[0] = 0;
-                        }
-                    }
-                    if (!found_cluster)
-                        scan = get_next_cluster(scan);
-                }
-
-                if (!found_cluster)
-                    return 0; // Not found
-
-                cluster = found_cluster;
-            }
+// -----------------------------------------------------------------------------
+// Open files. The table grows as files are opened. A handle's read buffer is
+// taken on the first read that needs it and handed back on close to a small
+// pool shared by all handles, which memory pressure can empty.
+// -----------------------------------------------------------------------------
+#define HANDLE_BUFFER_POOL 4
+
+typedef struct {
+    uint8_t *data;
+    uint32_t bytes;
+} HandleBuffer;
+
+static FAT32_FileHandle *fat32_open_files = NULL;
+static uint32_t open_file_capacity = 0;
+static HandleBuffer buffer_pool[HANDLE_BUFFER_POOL];
+static int buffer_reclaimer_added = 0;
+
+static size_t buffer_pool_shrink(size_t wanted) {
+    size_t freed = 0;
+    for (int i = 0; i < HANDLE_BUFFER_POOL && freed < wanted; i++) {
+        if (!buffer_pool[i].data)
+            continue;
+        free(buffer_pool[i].data);
+        buffer_pool[i].data = NULL;
+        freed += buffer_pool[i].bytes;
+    }
+    return freed;
+}
 
-            seg_i = 0;
-            if (c == '\0') break;
-        } else if (seg_i < 63) {
-            segment[seg_i++] = c;
+static uint8_t* buffer_take(uint32_t bytes) {
+    for (int i = 0; i < HANDLE_BUFFER_POOL; i++) {
+        if (buffer_pool[i].data && buffer_pool[i].bytes == bytes) {
+            uint8_t *data = buffer_pool[i].data;
+            buffer_pool[i].data = NULL;
+            return data;
         }
     }
-
-    return is_file ? file_size : 0;
+    return malloc(bytes);
 }
 
-static FAT32_FileHandle fat32_open_files[MAX_OPEN_FILES];
-
-static int fat32_alloc_handle(void) {
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        if (!fat32_open_files[i].used) {
-            fat32_open_files[i].used = 1;
-            return i;
+static void buffer_give(uint8_t *data, uint32_t bytes) {
+    if (!data)
+        return;
+    if (!buffer_reclaimer_added)
+        buffer_reclaimer_added = memory_add_reclaimer(buffer_pool_shrink) == 0;
+    for (int i = 0; buffer_reclaimer_added && i < HANDLE_BUFFER_POOL; i++) {
+        if (!buffer_pool[i].data) {
+            buffer_pool[i].data = data;
+            buffer_pool[i].bytes = bytes;
+            return;
         }
     }
-    return -1;
+    free(data);
 }
 
-void fat32_close_file(int handle) {
-    if (handle < 0 || handle >= MAX_OPEN_FILES) return;
-    fat32_open_files[handle].used = 0;
+static FAT32_FileHandle* handle_get(int handle) {
+    if (handle < 0 || (uint32_t)handle >= open_file_capacity || !fat32_open_files[handle].used)
+        return NULL;
+    return &fat32_open_files[handle];
 }
-int fat32_open_file(const char *path) {
-    if (!path || !path[0]) 
-        return -1;
 
-    uint32_t cluster = bpb.RootClus;
-    char segment[256];
-    int seg_i = 0;
-    int is_file = 0;
-    uint32_t file_size = 0;
+static int fat32_alloc_handle(void) {
+    uint32_t i = 0;
+    while (i < open_file_capacity && fat32_open_files[i].used)
+        i++;
+    if (i == open_file_capacity) {
+        uint32_t old = open_file_capacity;
+        if (grow_array((void **)&fat32_open_files, &open_file_capacity, old + 1, sizeof(FAT32_FileHandle)) < 0)
+            return -1;
+        memset(fat32_open_files + old, 0, (open_file_capacity - old) * sizeof(FAT32_FileHandle));
+    }
+    fat32_open_files[i].used = 1;
+    return (int)i;
+}
 
-    // Optional prefix stripping
-    if (str_starts_with(path, "/home/")) path += 6;
-    else if (path[0] == '/') path++;
+// Drops the handle's read buffer; the next miss takes one of the current size
+static void handle_release_buffer(FAT32_FileHandle *f) {
+    buffer_give(f->cache_buf, f->cache_bytes);
+    f->cache_buf = NULL;
+    f->cache_bytes = 0;
+    f->cache_count = 0;
+}
 
-    // Walk the path components
-    for (int i = 0;; i++) {
-        char c = path[i];
-        if (c == '/' || c == '\0') {
-            segment[seg_i] = 0;
-            if (seg_i > 0) {
-                uint32_t found_cluster = 0;
-                int eps = bpb.BytsPerSec / sizeof(struct FAT32_DirEntry);
-
-                uint32_t dir_cluster = cluster;
-                while (dir_cluster && !found_cluster) {
-                    uint8_t sb[512];
-                    uint32_t lba = cluster_to_lba(dir_cluster);
-
-                    for (int s = 0; s < bpb.SecPerClus && !found_cluster; s++) {
-                        ata_read_sector(lba + s, sb);
-                        struct FAT32_DirEntry *e = (struct FAT32_DirEntry *)sb;
-                        char lfn_buf[256]; 
-                        lfn_buf[0] = 0;
-
-                        for (int k = 0; k < eps; k++) {
-                            if (e[k].Name[0] == 0x00) break;      // end of directory
-                            if (e[k].Name[0] == 0xE5) {           // deleted entry
-                                lfn_buf[0] = 0;
-                                continue;
-                            }
-                            if (e[k].Attr == 0x0F) {
-                                // Long file name entry
-                                const struct FAT32_LFN_Entry *lfn = (const struct FAT32_LFN_Entry *)&e[k];
-                                lfn_prepend_piece(lfn_buf, lfn, sizeof(lfn_buf));
-                                continue;
-                            }
+// Takes a buffer for the handle's readahead, or for one cluster when memory is short
+static int handle_take_buffer(FAT32_FileHandle *f) {
+    if (f->cache_buf)
+        return 0;
+    uint32_t bytes = f->readahead * cluster_size;
+    f->cache_buf = buffer_take(bytes);
+    if (!f->cache_buf && f->readahead > 1) {
+        f->readahead = f->ra_window = 1;
+        bytes = cluster_size;
+        f->cache_buf = buffer_take(bytes);
+    }
+    if (!f->cache_buf)
+        return -1;
+    f->cache_bytes = bytes;
+    return 0;
+}
 
-                            // Standard 8.3 entry
-                            char shortnm[13];
-                            make_short_name_lower(e[k].Name, shortnm);
-                            const char *cand = choose_name(lfn_buf, shortnm);
-
-                            if (!strcasecmp(cand, segment)) {
-                                found_cluster = ((uint32_t)e[k].FstClusHI << 16) | e[k].FstClusLO;
-                                is_file = !(e[k].Attr & 0x10);
-                                if (is_file)
-                                    file_size = e[k].FileSize;
-                                break;
-                            }
+int fat32_close_file(int handle) {
+    FAT32_FileHandle *f = handle_get(handle);
+    if (!f)
+        return -1;
+    handle_release_buffer(f);
+    free(f->extents);
+    f->extents = NULL;
+    f->used = 0;
+    return 0;
+}
 
-                            lfn_buf[0] = 0; // reset after a valid entry
-                        }
-                    }
+int fat32_close_user_file(int handle) {
+    FAT32_FileHandle *f = handle_get(handle);
+    if (!f || f->kernel_owned)
+        return -1;
+    return fat32_close_file(handle);
+}
 
-                    if (!found_cluster)
-                        dir_cluster = get_next_cluster(dir_cluster);
+// Compresses the file's cluster chain into runs of consecutive clusters.
+// The walk stops after the clusters file_size needs, so a looped chain ends.
+static int build_extents(FAT32_FileHandle *f) {
+    uint32_t needed = (f->file_size + cluster_size - 1) / cluster_size;
+    uint32_t capacity = 0, count = 0;
+    FAT32_Extent *ext = NULL;
+    uint32_t cluster = f->start_cluster;
+    for (uint32_t i = 0; i < needed && cluster; i++) {
+        if (count && ext[count - 1].cluster + ext[count - 1].length == cluster) {
+            ext[count - 1].length++;
+        } else {
+            if (count == capacity) {
+                uint32_t grown = capacity ? capacity * 2 : 4;
+                FAT32_Extent *bigger = realloc(ext, grown * sizeof(FAT32_Extent));
+                if (!bigger) {
+                    free(ext);
+                    return -1;
                 }
-
-                if (!found_cluster)
-                    return -1; // Not found
-                cluster = found_cluster;
+                ext = bigger;
+                capacity = grown;
             }
-
-            seg_i = 0;
-            if (c == '\0') break;
-        } else if (seg_i < (int)(sizeof(segment) - 1)) {
-            segment[seg_i++] = c;
+            ext[count].first_index = i;
+            ext[count].cluster = cluster;
+            ext[count].length = 1;
+            count++;
         }
+        cluster = get_next_cluster(cluster);
     }
+    f->extents = ext;
+    f->extent_count = count;
+    return 0;
+}
 
-    if (!is_file) return -1;
-
+// Extent holding the file's `index`-th cluster, found by binary search;
+// NULL past the end of the chain
+static const FAT32_Extent* find_extent(const FAT32_FileHandle *f, uint32_t index) {
+    uint32_t lo = 0, hi = f->extent_count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (f->extents[mid].first_index <= index)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (!lo)
+        return NULL;
+    const FAT32_Extent *e = &f->extents[lo - 1];
+    return index - e->first_index < e->length ? e : NULL;
+}
+// Opens a handle on the entry at (dir, slot); errors as for fat32_open_file
+static int open_handle(uint32_t cluster, uint32_t file_size, uint32_t dir, uint32_t slot) {
     int handle = fat32_alloc_handle();
     if (handle < 0)
-        return -2; // no available handles
+        return -2; // the handle table cannot grow
 
     FAT32_FileHandle *f = &fat32_open_files[handle];
     memset(f, 0, sizeof(*f));
     f->used = 1;
     f->start_cluster = cluster;
-    f->current_cluster = cluster;
-    f->cluster_index = 0;
     f->file_size = file_size;
-    f->cache_valid = 0;
-    f->cached_cluster = 0;
-    f->bytes_read = 0;
+    f->dir = dir;
+    f->slot = slot;
+    f->readahead = FAT32_READAHEAD_DEFAULT;
+    if (f->readahead > FAT32_READAHEAD_DEFAULT_BYTES / cluster_size)
+        f->readahead = FAT32_READAHEAD_DEFAULT_BYTES / cluster_size;
+    if (!f->readahead)
+        f->readahead = 1;
+    if (build_extents(f) < 0) {
+        f->used = 0;
+        return -3; // no memory for the extent map
+    }
 
     return handle;
 }
 
-// --- Cluster-level read helper (safe and simple) ---
-static void ata_read_cluster(uint32_t cluster, uint8_t *dst) {
-    uint32_t lba = cluster_to_lba(cluster);
-    for (int s = 0; s < bpb.SecPerClus; s++, dst += bpb.BytsPerSec)
-        ata_read_sector(lba + s, dst);
+int fat32_open_file(const char *path) {
+    if (!path || !path[0]) 
+        return -1;
+
+    DentryInfo info;
+    uint32_t dir;
+    if (resolve_path(path, bpb.RootClus, &info, &dir) < 0 || info.is_dir)
+        return -1;
+    return open_handle(info.cluster, info.size, dir, info.slot);
+}
+
+int fat32_reopen_file(int handle) {
+    FAT32_FileHandle *f = handle_get(handle);
+    if (!f)
+        return -1;
+    return open_handle(f->start_cluster, f->file_size, f->dir, f->slot);
 }
 
-// --- Correct + fast replacement for fat32_read_chunk() ---
-size_t fat32_read_chunk(int handle, void *buf, size_t size, size_t position) {
-    if (handle < 0 || handle >= MAX_OPEN_FILES || !buf || size == 0)
+int fat32_reopen_owned(int handle) {
+    int own = fat32_reopen_file(handle);
+    if (own >= 0)
+        fat32_open_files[own].kernel_owned = 1;
+    return own;
+}
+
+int fat32_stat_file(int handle, FAT32_FileStat *out) {
+    FAT32_FileHandle *f = handle_get(handle);
+    if (!f || !out)
+        return -1;
+    out->id = (uint64_t)f->dir << 32 | f->slot;
+    out->size = f->file_size;
+    out->generation = f->generation;
+    return 0;
+}
+
+// Reads `count` clusters of the file from its `index`-th on into dst. Each
+// run of the extent map is one request (split at the device limit) and all
+// of them are in flight together. Returns the clusters read, fewer at the
+// end of the chain, or -1 if the device failed.
+static int read_file_clusters(const FAT32_FileHandle *f, uint32_t index, uint32_t count, uint8_t *dst) {
+    uint32_t max_request = volume->max_request ? volume->max_request : bpb.SecPerClus;
+    uint32_t done = 0, tags = 0;
+    int failed = 0;
+    while (done < count && !failed) {
+        const FAT32_Extent *e = find_extent(f, index + done);
+        if (!e)
+            break;
+        uint32_t offset = index + done - e->first_index;
+        uint32_t n = e->length - offset < count - done ? e->length - offset : count - done;
+        uint64_t lba = cluster_to_lba(e->cluster + offset);
+        uint32_t sectors = n * bpb.SecPerClus;
+        uint8_t *p = dst + (size_t)done * cluster_size;
+        while (sectors && !failed) {
+            uint32_t piece = sectors < max_request ? sectors : max_request;
+            int tag = block_submit(volume, lba, piece, p);
+            if (tag < 0 && tags) {  // queue full: drain it and retry
+                failed = block_wait(volume, tags) != 0;
+                tags = 0;
+                tag = failed ? -1 : block_submit(volume, lba, piece, p);
+            }
+            if (tag < 0) {
+                failed = 1;
+                break;
+            }
+            tags |= 1U << tag;
+            lba += piece;
+            p += (size_t)piece * bpb.BytsPerSec;
+            sectors -= piece;
+        }
+        done += n;
+    }
+    if (tags && block_wait(volume, tags) != 0)
+        failed = 1;
+    if (failed)
+        return -1;
+
+    // The data went around the buffer cache: lay unwritten blocks over it
+    for (uint32_t i = 0; i < done;) {
+        const FAT32_Extent *e = find_extent(f, index + i);
+        uint32_t offset = index + i - e->first_index;
+        uint32_t n = e->length - offset < done - i ? e->length - offset : done - i;
+        bcache_overlay(volume, cluster_to_lba(e->cluster + offset), n * bpb.SecPerClus,
+                       dst + (size_t)i * cluster_size);
+        i += n;
+    }
+    return (int)done;
+}
+
+uint32_t fat32_set_readahead(int handle, uint32_t clusters) {
+    FAT32_FileHandle *f = handle_get(handle);
+    if (!f)
         return 0;
+    uint32_t capacity = FAT32_READAHEAD_MAX_BYTES / cluster_size;
+    if (!capacity)
+        capacity = 1;
+    f->readahead = clusters < 1 ? 1 : clusters > capacity ? capacity : clusters;
+    if (f->ra_window > f->readahead)
+        f->ra_window = f->readahead;
+    if (f->cache_buf && (uint64_t)f->readahead * cluster_size > f->cache_bytes)
+        handle_release_buffer(f);
+    return f->readahead;
+}
 
-    FAT32_FileHandle *f = &fat32_open_files[handle];
-    if (!f->used || f->file_size == 0 || position >= f->file_size)
+// Any position maps to its cluster through the extent map. A miss at a
+// cluster boundary reads the whole clusters the request covers straight into
+// the caller's buffer; otherwise it refills cache_buf with at least the
+// clusters the request still needs, so only a partial head or tail is copied.
+// Reads that continue where the previous one ended also double a read-ahead
+// window, up to the handle's readahead, and random access shrinks it back to one.
+size_t fat32_read_chunk(int handle, void *buf, size_t size, size_t position) {
+    FAT32_FileHandle *f = handle_get(handle);
+    if (!f || !buf || size == 0 || f->file_size == 0 || position >= f->file_size)
         return 0;
 
-    const size_t bytes_per_cluster = bpb.BytsPerSec * bpb.SecPerClus;
+    const uint32_t file_clusters = (f->file_size + cluster_size - 1) / cluster_size;
     size_t bytes_read_total = 0;
     uint8_t *out = (uint8_t *)buf;
     size_t pos = position;
 
-    // Determine which cluster this position starts in
-    uint32_t cluster_index = pos / bytes_per_cluster;
-    size_t cluster_offset = pos % bytes_per_cluster;
-
-    // Find the correct cluster — try to reuse last one
-    uint32_t cluster = f->cached_cluster;
-    uint32_t current_idx = f->cluster_index;
-
-    if (!f->cache_valid || cluster == 0 || cluster_index < current_idx) {
-        // Start from the beginning of the chain
-        cluster = f->start_cluster;
-        current_idx = 0;
-    }
-
-    // Advance to desired cluster
-    while (current_idx < cluster_index && cluster) {
-        cluster = get_next_cluster(cluster);
-        current_idx++;
-    }
+    while (bytes_read_total < size && pos < f->file_size) {
+        uint32_t index = pos / cluster_size;
+        if (!f->cache_count || index < f->cache_first || index - f->cache_first >= f->cache_count) {
+            if (pos == f->bytes_read) {
+                uint32_t grown = f->ra_window ? f->ra_window * 2 : 1;
+                f->ra_window = grown < f->readahead ? grown : f->readahead;
+            } else {
+                f->ra_window = 1;
+            }
 
-    if (!cluster)
-        return 0;
+            // Full clusters wanted up to the request and EOF; DMA needs an even address
+            uint8_t *dst = out + bytes_read_total;
+            size_t span = size - bytes_read_total;
+            if (span > f->file_size - pos)
+                span = f->file_size - pos;
+            uint32_t direct = pos % cluster_size || ((uintptr_t)dst & 1) ? 0 : span / cluster_size;
+            if (direct) {
+                int got = read_file_clusters(f, index, direct, dst);
+                if (got <= 0)
+                    break;
+                bytes_read_total += (size_t)got * cluster_size;
+                pos += (size_t)got * cluster_size;
+                f->bytes_read = pos;
+                if ((uint32_t)got < direct)
+                    break; // chain shorter than the file size
+                continue;
+            }
 
-    // Read until requested size or EOF
-    while (bytes_read_total < size && pos < f->file_size && cluster) {
-        // Load current cluster if not cached
-        if (!f->cache_valid || f->cached_cluster != cluster) {
-            ata_read_cluster(cluster, f->cache_buf);
-            f->cached_cluster = cluster;
-            f->cache_valid = 1;
-            f->cluster_index = current_idx;
+            if (handle_take_buffer(f) < 0)
+                break;
+            size_t wanted = pos % cluster_size + (size - bytes_read_total);
+            uint32_t count = (wanted + cluster_size - 1) / cluster_size;
+            if (count < f->ra_window)
+                count = f->ra_window;
+            if (count > f->cache_bytes / cluster_size)
+                count = f->cache_bytes / cluster_size;
+            if (count > file_clusters - index)
+                count = file_clusters - index;
+            f->cache_count = 0;
+            int got = read_file_clusters(f, index, count, f->cache_buf);
+            if (got <= 0)
+                break; // device error, or chain shorter than the file size
+            f->cache_first = index;
+            f->cache_count = got;
         }
 
-        // Compute available bytes from this cluster
-        size_t available = bytes_per_cluster - cluster_offset;
+        // Copy what the cache holds from here, up to the request and EOF
+        size_t cache_offset = pos - (size_t)f->cache_first * cluster_size;
+        size_t available = (size_t)f->cache_count * cluster_size - cache_offset;
         size_t remaining = size - bytes_read_total;
         if (available > remaining)
             available = remaining;
@@ -1019,17 +1924,129 @@ size_t fat32_read_chunk(int handle, void *buf, size_t size, size_t position) {
         if (available > file_remaining)
             available = file_remaining;
 
-        // Copy from cache to user buffer
-        memcpy(out + bytes_read_total, f->cache_buf + cluster_offset, available);
+        memcpy(out + bytes_read_total, f->cache_buf + cache_offset, available);
         bytes_read_total += available;
         pos += available;
-
-        // Move to next cluster
-        cluster_offset = 0;
-        cluster = get_next_cluster(cluster);
-        current_idx++;
+        f->bytes_read = pos;
     }
 
-    f->bytes_read = pos;
     return bytes_read_total;
 }
+
+// -----------------------------------------------------------------------------
+// Writing. Data and metadata go through the write-back buffer cache, so
+// nothing is guaranteed on disk before fat32_sync.
+// -----------------------------------------------------------------------------
+// Brings handles open on the entry at (dir, slot) up to date after a change
+static void refresh_handles(uint32_t dir, uint32_t slot, uint32_t cluster, uint32_t size) {
+    for (uint32_t i = 0; i < open_file_capacity; i++) {
+        FAT32_FileHandle *f = &fat32_open_files[i];
+        if (!f->used || f->dir != dir || f->slot != slot)
+            continue;
+        free(f->extents);
+        f->extents = NULL;
+        f->extent_count = 0;
+        f->cache_count = 0;
+        f->generation++;
+        f->start_cluster = cluster;
+        f->file_size = size;
+        if (build_extents(f) < 0)
+            f->file_size = 0;  // without a map the handle cannot read anything
+    }
+}
+
+// The file `path` names, for writers. NULL if it does not exist, is a
+// directory or the volume cannot be written.
+static DirIndexEntry* writable_file(const char *path, uint32_t *dir) {
+    char leaf[256];
+    if (!volume || !volume->ops->write || !path || resolve_parent(path, dir, leaf) < 0)
+        return NULL;
+    DirIndex *index = dir_index_get(*dir);
+    DirIndexEntry *e = index ? dir_index_find(index, leaf) : NULL;
+    return (e && !(e->attr & (FAT_ATTR_DIR | 0x01))) ? e : NULL;  // 0x01: read-only
+}
+
+// Writes into the file of entry `e`, zero-filling any gap past its end
+static int file_write(uint32_t dir, DirIndexEntry *e, const void *data, uint32_t size, uint32_t offset) {
+    uint64_t end = (uint64_t)offset + size;
+    if (end > 0xFFFFFFFF)
+        return -1;
+    uint32_t first = e->cluster, old_size = e->size;
+    uint32_t new_size = end > old_size ? (uint32_t)end : old_size;
+    int result = chain_extend(&first, clusters_for(new_size));
+    if (!result && offset > old_size)
+        result = chain_write(first, old_size, NULL, offset - old_size);
+    if (!result)
+        result = chain_write(first, offset, data, size);
+    // Clusters already linked are recorded even if the write failed
+    uint32_t slot = e->slot;
+    if (dir_update_entry(dir, e, first, result ? old_size : new_size) != 0)
+        result = -1;
+    refresh_handles(dir, slot, first, result ? old_size : new_size);
+    return result;
+}
+
+int fat32_create(const char *path) {
+    uint32_t dir;
+    char leaf[256];
+    if (!volume || !volume->ops->write || !path || resolve_parent(path, &dir, leaf) < 0)
+        return -1;
+    DirIndex *index = dir_index_get(dir);
+    if (!index || dir_index_find(index, leaf))
+        return -1;
+    return dir_add_entry(dir, leaf, FAT_ATTR_ARCHIVE, 0, 0);
+}
+
+int fat32_write(const char *path, const void *data, uint32_t size, uint32_t offset) {
+    uint32_t dir;
+    DirIndexEntry *e = writable_file(path, &dir);
+    if (!e || (size && !data))
+        return -1;
+    return file_write(dir, e, data, size, offset);
+}
+
+int fat32_append(const char *path, const void *data, uint32_t size) {
+    uint32_t dir;
+    DirIndexEntry *e = writable_file(path, &dir);
+    if (!e || (size && !data))
+        return -1;
+    return file_write(dir, e, data, size, e->size);
+}
+
+int fat32_truncate(const char *path, uint32_t size) {
+    uint32_t dir;
+    DirIndexEntry *e = writable_file(path, &dir);
+    if (!e)
+        return -1;
+    if (size > e->size)
+        return file_write(dir, e, NULL, 0, size);
+    uint32_t first = e->cluster, slot = e->slot;
+    int result = chain_trim(&first, clusters_for(size));
+    if (dir_update_entry(dir, e, first, size) != 0)
+        result = -1;
+    refresh_handles(dir, slot, first, size);
+    return result;
+}
+
+int fat32_delete(const char *path) {
+    uint32_t dir;
+    DirIndexEntry *e = writable_file(path, &dir);
+    if (!e)
+        return -1;
+    uint32_t first = e->cluster, slot = e->slot;
+    if (dir_remove_entry(dir, slot, e->lfn_slots) != 0)  // e is gone after this
+        return -1;
+    refresh_handles(dir, slot, 0, 0);
+    return free_chain(first);
+}
+
+int fat32_sync(void) {
+    if (!volume)
+        return -1;
+    int result = fsinfo_store();
+    if (bcache_sync(volume) != 0)
+        result = -1;
+    if (block_flush(volume) != 0)
+        result = -1;
+    return result;
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 #include "../screen/screen.h"
+#include "block.h"
 
 struct FAT32_BPB {
     uint8_t  jmpBoot[3];
@@ -56,8 +57,10 @@ struct FAT32_Usage {
 // Public API
 // -----------------------------------------------------------------------------
 
-int fat32_init(uint32_t partition_lba_start);
-uint32_t find_fat32_partition();
+// Mounts the FAT32 volume starting at `partition_lba_start` of `dev`;
+// returns -1 (and keeps any earlier mount) if it is not one
+int fat32_init(BlockDevice *dev, uint32_t partition_lba_start);
+uint32_t find_fat32_partition(BlockDevice *dev);
 int fat32_ls(Window* win, uint32_t dir_cluster, int selected_index, int max_entries);
 void fat32_cd(Window* win, const char *path);
 void fat32_cat(Window* win, const char *filename);
@@ -65,28 +68,67 @@ struct FAT32_Usage fat32_get_usage(void);
 
 // Accessors
 uint32_t fat32_get_current_dir(void);
+BlockDevice* fat32_get_device(void);
 void fat32_set_current_dir(uint32_t cluster);
 const char *fat32_get_current_path(void);
 size_t fat32_read(char*buf,size_t bufsize,size_t start_page,const char*path);
 size_t fat32_get_file_size(const char *path);
 
-#define MAX_OPEN_FILES 16
 #define SECTOR_SIZE 512
+#define FAT32_READAHEAD_DEFAULT 16              // clusters, within FAT32_READAHEAD_DEFAULT_BYTES
+#define FAT32_READAHEAD_DEFAULT_BYTES (32 * 1024)
+#define FAT32_READAHEAD_MAX_BYTES (256 * 1024)  // largest read buffer a handle may ask for
+
+typedef struct {
+    uint32_t first_index;       // position of the run in the file, in clusters
+    uint32_t cluster;           // first cluster of the run on disk
+    uint32_t length;            // consecutive clusters in the run
+} FAT32_Extent;
 
 typedef struct {
     uint8_t  used;              // Whether this slot is active
     uint32_t start_cluster;     // First cluster of the file
-    uint32_t current_cluster;   // Current cluster in the chain
-    uint32_t last_cluster;      // Optional: for append / write operations
     uint32_t file_size;         // Total file size in bytes
-    uint32_t bytes_read;        // Total bytes read so far
-    uint32_t cluster_index;     // Index of current cluster (0 = first cluster)
-    uint32_t cached_cluster;    // Cluster number of currently cached data
-    uint8_t  cache_valid;       // Whether the cache is valid
-    uint8_t  cache_buf[64 * SECTOR_SIZE]; // Enough for up to 32KB clusters
+    uint32_t dir;               // Directory holding the file's entry
+    uint32_t slot;              // Position of the entry there, to follow writes
+    uint32_t bytes_read;        // Position after the last read
+    FAT32_Extent *extents;      // Cluster chain as runs, sorted by first_index
+    uint32_t extent_count;
+    uint8_t *cache_buf;         // readahead clusters, taken on the first miss that needs it
+    uint32_t cache_bytes;       // Size of cache_buf (0 = not taken yet)
+    uint32_t cache_first;       // Index of the first cluster held in cache_buf
+    uint32_t cache_count;       // Clusters held in cache_buf (0 = empty)
+    uint32_t readahead;         // Most clusters prefetched on a sequential miss
+    uint32_t ra_window;         // Current prefetch, grows while reads stay sequential
+    uint32_t generation;        // Writes to the file since it was opened
+    uint8_t  kernel_owned;      // Closed only by its owner, never by a console command
 } FAT32_FileHandle;
 
+typedef struct {
+    uint64_t id;                // Same file, same id, whatever path or handle reached it
+    uint32_t size;
+    uint32_t generation;        // Changes whenever a write changes the file
+} FAT32_FileStat;
+
 int    fat32_open_file(const char *path);
-void   fat32_close_file(int handle);
+int    fat32_reopen_file(int handle);  // second handle on the same file, same errors
+int    fat32_reopen_owned(int handle);  // same, but fat32_close_user_file refuses it
+int    fat32_close_file(int handle);  // 0, or -1 if the handle was not open
+int    fat32_close_user_file(int handle);  // same, and -1 for a kernel-owned handle
+int    fat32_stat_file(int handle, FAT32_FileStat *out);  // 0, or -1 for a bad handle
 size_t fat32_read_chunk(int handle, void *buf, size_t size, size_t position);
+// Sets how many clusters sequential reads may prefetch (1 turns read-ahead
+// off); returns the value kept after clamping to FAT32_READAHEAD_MAX_BYTES
+uint32_t fat32_set_readahead(int handle, uint32_t clusters);
 int fat32_get_entry_name(uint32_t dir_cluster, int index, char *out, size_t out_size);
+
+// Writing. Relative paths start at the current directory. Changes sit in
+// the buffer cache until fat32_sync (or until the cache needs the room);
+// open handles on a changed file see the new contents and size.
+// Each returns 0, -1 on a bad path or device error, -2 if the volume is full.
+int fat32_create(const char *path);    // empty file; fails if the name exists
+int fat32_write(const char *path, const void *data, uint32_t size, uint32_t offset);
+int fat32_append(const char *path, const void *data, uint32_t size);
+int fat32_truncate(const char *path, uint32_t size);  // growing fills with zeros
+int fat32_delete(const char *path);    // files only
+int fat32_sync(void);                  // writes back everything and flushes the device
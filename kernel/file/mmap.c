@@ -0,0 +1,321 @@
+#include "../memory/memory.h"
+#include "../string.h"
+#include "fat32.h"
+#include "mmap.h"
+
+typedef struct {
+    uint8_t   used;
+    uint8_t   stale;       // written since: no new mappings, dropped with the last one
+    int       handle;      // the file's own kernel-owned handle, pages are read through it
+    uint64_t  id;          // FAT32_FileStat.id
+    uint32_t  generation;  // of `handle` when it was opened
+    uint32_t  page_count;
+    uint32_t *pages;       // per page: its cache slot + 1, or 0 if not cached
+    uint32_t  mappings;
+    uint64_t  last_used;   // the least recent idle file is replaced first
+} MappedFile;
+
+typedef struct {
+    uint64_t base;         // 0 if the entry is free
+    uint64_t pages;
+    int      file;         // index in files
+    uint8_t  error;        // a page could not be read and reads as zeros
+} Mapping;
+
+typedef struct {
+    uint64_t base;
+    uint64_t pages;        // 0 if the entry is free
+} Hole;
+
+typedef struct {
+    int      file;         // owner's index in files, -1 if free
+    uint32_t page;
+    uint8_t  referenced;   // faulted since the clock hand last passed
+} PageSlot;
+
+static MappedFile files[MMAP_FILES];
+static Mapping mappings[MMAP_MAPPINGS];
+static PageSlot slots[MMAP_CACHE_PAGES];
+static uint64_t slot_phys[MMAP_CACHE_PAGES];
+static uint8_t *pool = NULL;  // slot s is mapped writable at pool + s pages
+static uint64_t zero_phys = 0;  // mapped where a page could not be read
+// Address space of released mappings. Live mappings split it into at most
+// one more hole than there are of them.
+static Hole holes[MMAP_MAPPINGS + 1];
+static uint32_t slot_count = 0;
+static uint32_t clock_hand = 0;
+static uint64_t use_clock = 0;
+static MmapStats stats;
+
+static inline uint8_t* slot_data(uint32_t s) {
+    return pool + (size_t)s * PAGE_SIZE_4K;
+}
+
+// ==== Page cache ====
+// Backs the next slot with a frame; -1 at the limit or when none is left
+static int slot_grow(void) {
+    if (slot_count == MMAP_CACHE_PAGES || !pmm_reserve(PAGE_SIZE_4K))
+        return -1;
+    uint64_t frame = pmm_alloc_frame();
+    if (!frame || paging_map((uint64_t)(uintptr_t)slot_data(slot_count), frame, PAGE_SIZE_4K, PAGE_RW))
+        return -1;
+    slot_phys[slot_count] = frame;
+    slots[slot_count].file = -1;
+    stats.pages++;
+    return (int)slot_count++;
+}
+
+// Takes the page out of its file and out of every mapping of that file
+static void slot_evict(uint32_t s) {
+    PageSlot *p = &slots[s];
+    for (int m = 0; m < MMAP_MAPPINGS; m++)
+        if (mappings[m].base && mappings[m].file == p->file)
+            paging_unmap(mappings[m].base + (uint64_t)p->page * PAGE_SIZE_4K);
+    files[p->file].pages[p->page] = 0;
+    p->file = -1;
+    stats.evictions++;
+}
+
+// A free slot, else a new one, else the first one past the clock hand that
+// was not faulted since the hand last passed it
+static int slot_take(void) {
+    for (uint32_t s = 0; s < slot_count; s++)
+        if (slots[s].file < 0)
+            return (int)s;
+    int grown = slot_grow();
+    if (grown >= 0 || !slot_count)
+        return grown;
+    for (;;) {
+        uint32_t s = clock_hand;
+        clock_hand = (clock_hand + 1) % slot_count;
+        if (slots[s].referenced) {
+            slots[s].referenced = 0;
+            continue;
+        }
+        slot_evict(s);
+        return (int)s;
+    }
+}
+
+// ==== Address space ====
+// First fit among the holes, else new address space from the window
+static uint64_t va_take(uint64_t pages) {
+    for (int h = 0; h <= MMAP_MAPPINGS; h++)
+        if (holes[h].pages >= pages) {
+            uint64_t base = holes[h].base;
+            holes[h].base += pages * PAGE_SIZE_4K;
+            holes[h].pages -= pages;
+            return base;
+        }
+    return (uint64_t)(uintptr_t)paging_map_window_take(pages * PAGE_SIZE_4K);
+}
+
+// Returns unmapped address space, merged with the holes next to it
+static void va_give(uint64_t base, uint64_t pages) {
+    int free_hole = -1;
+    for (int h = 0; h <= MMAP_MAPPINGS; h++) {
+        Hole *o = &holes[h];
+        if (!o->pages) {
+            if (free_hole < 0)
+                free_hole = h;
+            continue;
+        }
+        if (o->base + o->pages * PAGE_SIZE_4K == base || base + pages * PAGE_SIZE_4K == o->base) {
+            if (o->base < base)
+                base = o->base;
+            pages += o->pages;
+            o->pages = 0;
+            h = -1;  // the merged hole may now touch another one
+            free_hole = -1;
+        }
+    }
+    if (free_hole >= 0) {
+        holes[free_hole].base = base;
+        holes[free_hole].pages = pages;
+    }
+}
+
+// ==== Files ====
+static void file_drop(int i) {
+    for (uint32_t s = 0; s < slot_count; s++)
+        if (slots[s].file == i)
+            slots[s].file = -1;
+    free(files[i].pages);
+    files[i].pages = NULL;
+    fat32_close_file(files[i].handle);
+    files[i].used = 0;
+}
+
+// The cached file `st` describes, set up on first use from `handle`. Files
+// written since they were cached are retired on the way.
+static int file_get(int handle, const FAT32_FileStat *st) {
+    int empty = -1, idle = -1;
+    for (int i = 0; i < MMAP_FILES; i++) {
+        MappedFile *f = &files[i];
+        if (f->used && !f->stale) {
+            FAT32_FileStat own;
+            f->stale = fat32_stat_file(f->handle, &own) < 0 || own.id != f->id
+                       || own.generation != f->generation;
+        }
+        if (f->used && f->stale && !f->mappings)
+            file_drop(i);
+        if (!f->used) {
+            if (empty < 0)
+                empty = i;
+            continue;
+        }
+        if (!f->stale && f->id == st->id)
+            return i;
+        if (!f->mappings && (idle < 0 || f->last_used < files[idle].last_used))
+            idle = i;
+    }
+    if (empty < 0 && idle >= 0) {
+        file_drop(idle);
+        empty = idle;
+    }
+    if (empty < 0)
+        return -1;
+
+    uint32_t page_count = (st->size + PAGE_SIZE_4K - 1) / PAGE_SIZE_4K;
+    uint32_t *pages = malloc(page_count * sizeof(uint32_t));
+    if (!pages)
+        return -1;
+    memset(pages, 0, page_count * sizeof(uint32_t));
+    FAT32_FileStat own;
+    int own_handle = fat32_reopen_owned(handle);
+    if (own_handle < 0 || fat32_stat_file(own_handle, &own) < 0) {
+        free(pages);
+        return -1;
+    }
+    MappedFile *f = &files[empty];
+    f->used = 1;
+    f->stale = 0;
+    f->handle = own_handle;
+    f->id = own.id;
+    f->generation = own.generation;
+    f->page_count = page_count;
+    f->pages = pages;
+    f->mappings = 0;
+    return empty;
+}
+
+// ==== Faults ====
+// A page that cannot be read is mapped to zeros and flags its mapping: the
+// fault cannot fail without halting, so owners check mmap_error instead
+static int mmap_fault(uint64_t page, uint64_t error) {
+    if (error & PF_WRITE)
+        return -1;  // mappings are read-only
+    Mapping *map = NULL;
+    for (int m = 0; m < MMAP_MAPPINGS && !map; m++)
+        if (mappings[m].base && page >= mappings[m].base
+                && page - mappings[m].base < mappings[m].pages * PAGE_SIZE_4K)
+            map = &mappings[m];
+    if (!map)
+        return -1;
+
+    MappedFile *f = &files[map->file];
+    uint32_t index = (page - map->base) / PAGE_SIZE_4K;
+    int s;
+    if (f->pages[index]) {
+        s = (int)f->pages[index] - 1;  // another mapping read it, or it was unmapped
+        stats.hits++;
+    } else {
+        // Whole clusters go straight into the frame; past EOF stays zero
+        FAT32_FileStat st;
+        s = slot_take();
+        if (s < 0 || fat32_stat_file(f->handle, &st) < 0) {
+            map->error = 1;
+            return paging_map(page, zero_phys, PAGE_SIZE_4K, 0);
+        }
+        size_t offset = (size_t)index * PAGE_SIZE_4K;
+        size_t wanted = st.size > offset ? st.size - offset : 0;
+        if (wanted > PAGE_SIZE_4K)
+            wanted = PAGE_SIZE_4K;
+        uint8_t *data = slot_data(s);
+        if (wanted && fat32_read_chunk(f->handle, data, wanted, offset) != wanted) {
+            map->error = 1;  // the slot stays free
+            return paging_map(page, zero_phys, PAGE_SIZE_4K, 0);
+        }
+        memset(data + wanted, 0, PAGE_SIZE_4K - wanted);
+        slots[s].file = map->file;
+        slots[s].page = index;
+        f->pages[index] = s + 1;
+        stats.misses++;
+    }
+    slots[s].referenced = 1;
+    return paging_map(page, slot_phys[s], PAGE_SIZE_4K, 0);
+}
+
+// ==== Public API ====
+const void* mmap_file(int handle, size_t *size) {
+    FAT32_FileStat st;
+    if (fat32_stat_file(handle, &st) < 0 || !st.size)
+        return NULL;
+    int m = 0;
+    while (m < MMAP_MAPPINGS && mappings[m].base)
+        m++;
+    if (m == MMAP_MAPPINGS)
+        return NULL;
+    if (!pool) {
+        // The zero page sits right after the slots
+        uint8_t *window = paging_map_window_take((MMAP_CACHE_PAGES + 1) * PAGE_SIZE_4K);
+        if (!window || !pmm_reserve(PAGE_SIZE_4K))
+            return NULL;
+        uint8_t *zero = window + MMAP_CACHE_PAGES * PAGE_SIZE_4K;
+        uint64_t frame = pmm_alloc_frame();
+        if (!frame || paging_map((uint64_t)(uintptr_t)zero, frame, PAGE_SIZE_4K, PAGE_RW))
+            return NULL;
+        memset(zero, 0, PAGE_SIZE_4K);
+        zero_phys = frame;
+        pool = window;
+        paging_set_map_fault_handler(mmap_fault);
+    }
+
+    int i = file_get(handle, &st);
+    if (i < 0)
+        return NULL;
+    uint64_t base = va_take(files[i].page_count);
+    if (!base)
+        return NULL;
+    mappings[m].base = base;
+    mappings[m].pages = files[i].page_count;
+    mappings[m].file = i;
+    mappings[m].error = 0;
+    files[i].mappings++;
+    files[i].last_used = ++use_clock;
+    stats.mappings++;
+    if (size)
+        *size = st.size;
+    return (const void*)(uintptr_t)base;
+}
+
+void mmap_release(const void *addr) {
+    for (int m = 0; m < MMAP_MAPPINGS; m++) {
+        Mapping *map = &mappings[m];
+        if (!map->base || map->base != (uint64_t)(uintptr_t)addr)
+            continue;
+        // Only cached pages can be mapped, eviction unmaps the rest, unless
+        // a page could not be read and got the zero page
+        MappedFile *f = &files[map->file];
+        for (uint64_t p = 0; p < map->pages; p++)
+            if (f->pages[p] || map->error)
+                paging_unmap(map->base + p * PAGE_SIZE_4K);
+        va_give(map->base, map->pages);
+        map->base = 0;
+        stats.mappings--;
+        if (!--f->mappings && f->stale)
+            file_drop(map->file);
+        return;
+    }
+}
+
+int mmap_error(const void *addr) {
+    for (int m = 0; m < MMAP_MAPPINGS; m++)
+        if (mappings[m].base && mappings[m].base == (uint64_t)(uintptr_t)addr)
+            return mappings[m].error;
+    return 0;
+}
+
+void mmap_get_stats(MmapStats *out) {
+    *out = stats;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Read-only file mappings. A mapping is address space in the paging mapping
+// window; each page is read on first touch into a page cache shared by every
+// mapping of the same file, then mapped read-only. The cache holds at most
+// MMAP_CACHE_PAGES frames and reuses the least recently faulted ones, which
+// just fault in again when touched. Pages are read through the file system,
+// so mapped memory must not be passed to the FAT32 writers. Unmapping only
+// flushes the local TLB: use a mapping from one CPU at a time.
+// A write to a mapped file gives later mappings fresh pages; existing ones
+// keep what they already touched.
+#define MMAP_CACHE_PAGES 256  // 1 MB of file data
+#define MMAP_FILES       16   // files with cached pages
+#define MMAP_MAPPINGS    32   // live mappings
+
+typedef struct {
+    uint64_t hits;       // faults served from the page cache
+    uint64_t misses;     // pages read from the file
+    uint64_t evictions;  // cached pages reused for others
+    uint64_t pages;      // frames the cache holds now
+    uint64_t mappings;   // live mappings
+} MmapStats;
+
+// Maps the whole file `handle` reads. The mapping keeps a handle of its own,
+// so `handle` may be closed right after. Returns the address and sets *size
+// (if not NULL) to the file size; NULL for an empty file or when out of
+// mappings, address space or memory.
+const void* mmap_file(int handle, size_t *size);
+
+// Ends the mapping that mmap_file returned at `addr`; its address space is
+// reused by later mappings
+void mmap_release(const void *addr);
+
+// Nonzero if a page of the mapping at `addr` could not be read. Such a page
+// reads as zeros, so check this after reading and before trusting the data.
+int mmap_error(const void *addr);
+
+void mmap_get_stats(MmapStats *out);
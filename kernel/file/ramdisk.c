@@ -0,0 +1,62 @@
+#include <stddef.h>
+#include "../memory/memory.h"
+#include "../string.h"
+#include "ramdisk.h"
+
+#define RAMDISK_BLOCK_SIZE 512
+
+typedef struct {
+    BlockDevice block;
+    uint8_t *data;
+} RamDisk;
+
+static int ramdisk_count = 0;
+
+static int ramdisk_read(BlockDevice *dev, uint64_t lba, uint32_t count, void *buffer) {
+    RamDisk *disk = dev->driver;
+    memcpy(buffer, disk->data + lba * RAMDISK_BLOCK_SIZE, (size_t)count * RAMDISK_BLOCK_SIZE);
+    return 0;
+}
+
+static int ramdisk_write(BlockDevice *dev, uint64_t lba, uint32_t count, const void *buffer) {
+    RamDisk *disk = dev->driver;
+    memcpy(disk->data + lba * RAMDISK_BLOCK_SIZE, buffer, (size_t)count * RAMDISK_BLOCK_SIZE);
+    return 0;
+}
+
+static const BlockDeviceOps ramdisk_ops = {
+    .read = ramdisk_read,
+    .write = ramdisk_write,
+};
+
+BlockDevice* ramdisk_create(uint64_t blocks) {
+    if (!blocks || ramdisk_count >= 10)
+        return NULL;
+    RamDisk *disk = malloc(sizeof(RamDisk));
+    if (!disk)
+        return NULL;
+    disk->data = malloc(blocks * RAMDISK_BLOCK_SIZE);
+    if (!disk->data) {
+        free(disk);
+        return NULL;
+    }
+    memset(disk->data, 0, blocks * RAMDISK_BLOCK_SIZE);
+
+    BlockDevice *dev = &disk->block;
+    str_copy(dev->name, "ram0", BLOCK_NAME_LEN);
+    dev->name[3] += ramdisk_count;
+    dev->ops = &ramdisk_ops;
+    dev->driver = disk;
+    dev->block_size = RAMDISK_BLOCK_SIZE;
+    dev->blocks = blocks;
+    dev->max_request = (uint32_t)(blocks < 0xFFFFFFFF ? blocks : 0xFFFFFFFF);
+    dev->kind = "RAM";
+    dev->model = NULL;
+    if (block_register(dev) < 0) {
+        free(disk->data);
+        free(disk);
+        return NULL;
+    }
+    ramdisk_count++;
+    return dev;
+}
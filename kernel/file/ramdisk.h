@@ -0,0 +1,7 @@
+#pragma once
+#include <stdint.h>
+#include "block.h"
+
+// Creates and registers a zero-filled RAM disk of `blocks` 512-byte blocks
+// (ram0, ram1, ...). Returns NULL if memory or the device table runs out.
+BlockDevice* ramdisk_create(uint64_t blocks);
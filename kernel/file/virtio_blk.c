@@ -0,0 +1,440 @@
+#include <stddef.h>
+#include "../io.h"
+#include "../interrupts.h"
+#include "../memory/paging.h"
+#include "../pci/pci.h"
+#include "../smp/spinlock.h"
+#include "../string.h"
+#include "virtio_blk.h"
+
+#define VIRTIO_VENDOR_ID        0x1AF4
+#define VIRTIO_BLK_LEGACY_ID    0x1001  // transitional device, legacy registers in BAR0
+
+// Legacy register block
+#define VIRTIO_REG_HOST_FEATURES  0x00
+#define VIRTIO_REG_GUEST_FEATURES 0x04
+#define VIRTIO_REG_QUEUE_PFN      0x08
+#define VIRTIO_REG_QUEUE_SIZE     0x0C
+#define VIRTIO_REG_QUEUE_SELECT   0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY   0x10
+#define VIRTIO_REG_STATUS         0x12
+#define VIRTIO_REG_ISR            0x13
+#define VIRTIO_REG_CONFIG         0x14  // virtio-blk: capacity (u64) first
+
+#define VIRTIO_STATUS_ACK         0x01
+#define VIRTIO_STATUS_DRIVER      0x02
+#define VIRTIO_STATUS_DRIVER_OK   0x04
+
+#define VRING_DESC_F_NEXT         0x01
+#define VRING_DESC_F_WRITE        0x02  // device writes this buffer
+#define VRING_AVAIL_F_NO_INTERRUPT 0x01
+#define VRING_USED_F_NO_NOTIFY    0x01
+#define VRING_ALIGN               4096
+
+#define VIRTIO_BLK_T_IN           0
+#define VIRTIO_BLK_T_OUT          1
+#define VIRTIO_BLK_T_FLUSH        4
+#define VIRTIO_BLK_F_RO           (1U << 5)
+#define VIRTIO_BLK_F_FLUSH        (1U << 9)
+#define VIRTIO_BLK_MAX_SEGMENTS   64    // data descriptors per request
+#define VIRTIO_TIMEOUT            10000000
+#define SECTOR_BYTES              512
+
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) VringDesc;
+
+typedef struct {
+    uint16_t flags;
+    volatile uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed)) VringAvail;
+
+typedef struct {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed)) VringUsedElem;
+
+typedef struct {
+    volatile uint16_t flags;
+    volatile uint16_t idx;
+    VringUsedElem ring[];
+} __attribute__((packed)) VringUsed;
+
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) VirtioBlkHeader;
+
+// Request page: one header per tag, then one status byte per tag
+typedef struct {
+    VirtioBlkHeader header[VIRTIO_BLK_MAX_REQUESTS];
+    volatile uint8_t status[VIRTIO_BLK_MAX_REQUESTS];
+} VirtioBlkRequests;
+
+typedef struct {
+    uint64_t phys;
+    uint32_t len;
+} VirtioSegment;
+
+static VirtioBlkDisk virtio_disks[VIRTIO_BLK_MAX_DISKS];
+static int virtio_count = 0;
+
+static inline void virtio_fence(void) {
+    __asm__ volatile("mfence" : : : "memory");
+}
+
+// ==== Completion ====
+// Retires every used-ring entry: records the status and returns the chain
+// to the free list. Runs with interrupts off (from the ISR or a waiter).
+static void virtio_blk_reap(VirtioBlkDisk *disk) {
+    VringDesc *desc = disk->desc;
+    VringUsed *used = disk->used;
+    VirtioBlkRequests *req = disk->requests;
+    while (disk->last_used != used->idx) {
+        virtio_fence();
+        uint16_t head = (uint16_t)used->ring[disk->last_used % disk->queue_size].id;
+        disk->last_used++;
+        for (int tag = 0; tag < VIRTIO_BLK_MAX_REQUESTS; tag++) {
+            uint32_t bit = 1U << tag;
+            if (!(disk->busy & bit) || disk->head_of[tag] != head)
+                continue;
+            if (req->status[tag] != 0)
+                disk->failed |= bit;
+            disk->busy &= ~bit;
+            break;
+        }
+        uint16_t i = head;
+        for (;;) {
+            uint16_t flags = desc[i].flags;
+            uint16_t next = desc[i].next;
+            desc[i].next = disk->free_head;
+            disk->free_head = i;
+            disk->free_count++;
+            if (!(flags & VRING_DESC_F_NEXT))
+                break;
+            i = next;
+        }
+    }
+}
+
+// Reading the ISR register acknowledges the interrupt and drops INTx
+static void virtio_blk_irq(void *arg) {
+    VirtioBlkDisk *disk = arg;
+    if (inb(disk->io + VIRTIO_REG_ISR) & 1)
+        virtio_blk_reap(disk);
+}
+
+// ==== Requests ====
+// Splits the buffer into physically contiguous runs. Returns the run count or -1.
+static int virtio_segments(VirtioSegment *seg, uint8_t *buf, uint32_t bytes) {
+    int n = 0;
+    while (bytes) {
+        uintptr_t virt = (uintptr_t)buf;
+        uint32_t len = PAGE_SIZE_4K - (virt & (PAGE_SIZE_4K - 1));
+        if (len > bytes)
+            len = bytes;
+        (void)*(volatile uint8_t *)buf;  // commit a demand-paged heap page first
+        uint64_t phys = paging_virt_to_phys(virt);
+        if (!phys)
+            return -1;
+        if (n && seg[n - 1].phys + seg[n - 1].len == phys) {
+            seg[n - 1].len += len;
+        } else {
+            if (n == VIRTIO_BLK_MAX_SEGMENTS)
+                return -1;
+            seg[n].phys = phys;
+            seg[n].len = len;
+            n++;
+        }
+        buf += len;
+        bytes -= len;
+    }
+    return n;
+}
+
+static uint16_t virtio_take_desc(VirtioBlkDisk *disk) {
+    VringDesc *desc = disk->desc;
+    uint16_t i = disk->free_head;
+    disk->free_head = desc[i].next;
+    disk->free_count--;
+    return i;
+}
+
+// Places one request of `type` in the ring. A flush carries no data.
+static int virtio_blk_queue(VirtioBlkDisk *disk, uint32_t type, uint64_t lba, uint32_t count, void *buffer) {
+    VirtioSegment seg[VIRTIO_BLK_MAX_SEGMENTS];
+    if (!disk || count > VIRTIO_BLK_MAX_SECTORS || lba + count > disk->sectors)
+        return -1;
+    if (!count && type != VIRTIO_BLK_T_FLUSH)
+        return -1;
+    int segments = virtio_segments(seg, buffer, count * SECTOR_BYTES);
+    if (segments < 0)
+        return -1;
+
+    uint64_t flags = irq_save();
+    int tag = -1;
+    for (int t = 0; t < VIRTIO_BLK_MAX_REQUESTS && tag < 0; t++)
+        if (!(disk->busy & (1U << t)))
+            tag = t;
+    if (tag < 0 || disk->free_count < segments + 2) {
+        irq_restore(flags);
+        return -1;
+    }
+
+    VringDesc *desc = disk->desc;
+    VirtioBlkRequests *req = disk->requests;
+    uint64_t req_phys = disk->requests_phys;
+    req->header[tag].type = type;
+    req->header[tag].reserved = 0;
+    req->header[tag].sector = lba;
+    req->status[tag] = 0xFF;
+
+    // header -> data segments -> status byte
+    uint16_t head = virtio_take_desc(disk);
+    uint16_t prev = head;
+    desc[head].addr = req_phys + offsetof(VirtioBlkRequests, header) + tag * sizeof(VirtioBlkHeader);
+    desc[head].len = sizeof(VirtioBlkHeader);
+    desc[head].flags = VRING_DESC_F_NEXT;
+    for (int s = 0; s <= segments; s++) {
+        uint16_t d = virtio_take_desc(disk);
+        desc[prev].next = d;
+        if (s < segments) {
+            desc[d].addr = seg[s].phys;
+            desc[d].len = seg[s].len;
+            desc[d].flags = (type == VIRTIO_BLK_T_IN ? VRING_DESC_F_WRITE : 0) | VRING_DESC_F_NEXT;
+        } else {
+            desc[d].addr = req_phys + offsetof(VirtioBlkRequests, status) + tag;
+            desc[d].len = 1;
+            desc[d].flags = VRING_DESC_F_WRITE;
+        }
+        prev = d;
+    }
+
+    VringAvail *avail = disk->avail;
+    avail->ring[disk->avail_shadow % disk->queue_size] = head;
+    disk->avail_shadow++;
+    disk->head_of[tag] = head;
+    disk->busy |= 1U << tag;
+    disk->failed &= ~(1U << tag);
+    irq_restore(flags);
+    return tag;
+}
+
+int virtio_blk_submit(VirtioBlkDisk *disk, uint64_t lba, uint32_t count, void *buffer) {
+    return virtio_blk_queue(disk, VIRTIO_BLK_T_IN, lba, count, buffer);
+}
+
+void virtio_blk_kick(VirtioBlkDisk *disk) {
+    VringAvail *avail = disk->avail;
+    VringUsed *used = disk->used;
+    if (avail->idx == disk->avail_shadow)
+        return;
+    virtio_fence();  // ring entries before the index
+    avail->idx = disk->avail_shadow;
+    virtio_fence();  // index before reading the device's notify hint
+    if (!(used->flags & VRING_USED_F_NO_NOTIFY))
+        outw(disk->io + VIRTIO_REG_QUEUE_NOTIFY, 0);
+}
+
+int virtio_blk_wait(VirtioBlkDisk *disk, uint32_t tags) {
+    for (int i = 0; i < VIRTIO_TIMEOUT; i++) {
+        uint64_t flags = irq_save();
+        virtio_blk_reap(disk);
+        if (!(disk->busy & tags)) {
+            irq_restore(flags);
+            break;
+        }
+        if ((flags & 0x200) && disk->irq != 0xFF) {
+            // No timer is running to wake a hlt, so spin with interrupts on
+            __asm__ volatile("sti; pause" : : : "memory");
+            continue;
+        }
+        // Interrupts are not on yet: acknowledge by hand so INTx drops
+        inb(disk->io + VIRTIO_REG_ISR);
+        irq_restore(flags);
+        __asm__ volatile("pause");
+    }
+    uint64_t flags = irq_save();
+    int result = ((disk->busy | disk->failed) & tags) ? -1 : 0;
+    disk->failed &= ~tags;
+    irq_restore(flags);
+    return result;
+}
+
+static int virtio_blk_transfer(VirtioBlkDisk *disk, uint32_t type, uint64_t lba, uint32_t count, uint8_t *buf) {
+    uint32_t tags = 0;
+    int result = 0;
+    while (count) {
+        uint32_t n = count < VIRTIO_BLK_MAX_SECTORS ? count : VIRTIO_BLK_MAX_SECTORS;
+        int tag = virtio_blk_queue(disk, type, lba, n, buf);
+        if (tag < 0) {
+            if (!tags)
+                return -1;  // nothing in flight, so the request itself is bad
+            virtio_blk_kick(disk);
+            result |= virtio_blk_wait(disk, tags);
+            tags = 0;
+            continue;
+        }
+        tags |= 1U << tag;
+        lba += n;
+        buf += n * SECTOR_BYTES;
+        count -= n;
+    }
+    virtio_blk_kick(disk);  // the whole batch in one notification
+    result |= virtio_blk_wait(disk, tags);
+    return result ? -1 : 0;
+}
+
+int virtio_blk_read(VirtioBlkDisk *disk, uint64_t lba, uint32_t count, void *buffer) {
+    return virtio_blk_transfer(disk, VIRTIO_BLK_T_IN, lba, count, buffer);
+}
+
+// The device only reads the data of an OUT request, so the cast is safe
+int virtio_blk_write(VirtioBlkDisk *disk, uint64_t lba, uint32_t count, const void *buffer) {
+    if (!disk || disk->read_only)
+        return -1;
+    return virtio_blk_transfer(disk, VIRTIO_BLK_T_OUT, lba, count, (uint8_t *)buffer);
+}
+
+// Without the FLUSH feature the device writes through, so there is nothing to do
+int virtio_blk_flush(VirtioBlkDisk *disk) {
+    if (!disk || !disk->flush)
+        return disk ? 0 : -1;
+    int tag = virtio_blk_queue(disk, VIRTIO_BLK_T_FLUSH, 0, 0, NULL);
+    if (tag < 0)
+        return -1;
+    virtio_blk_kick(disk);
+    return virtio_blk_wait(disk, 1U << tag);
+}
+
+// ==== Discovery ====
+static int virtio_blk_setup(VirtioBlkDisk *disk, const PciDevice *pci) {
+    int is_io;
+    uint64_t bar = pci_bar(pci, 0, &is_io);
+    if (!bar || !is_io)
+        return -1;
+    pci_enable(pci, PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+    uint16_t io = disk->io = (uint16_t)bar;
+
+    outb(io + VIRTIO_REG_STATUS, 0);  // reset
+    outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACK);
+    outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER);
+    uint32_t features = inl(io + VIRTIO_REG_HOST_FEATURES);
+    disk->read_only = (features & VIRTIO_BLK_F_RO) != 0;
+    disk->flush = (features & VIRTIO_BLK_F_FLUSH) != 0;
+    outl(io + VIRTIO_REG_GUEST_FEATURES, features & VIRTIO_BLK_F_FLUSH);
+
+    outw(io + VIRTIO_REG_QUEUE_SELECT, 0);
+    uint16_t size = inw(io + VIRTIO_REG_QUEUE_SIZE);
+    if (!size)
+        return -1;
+    uint64_t used_offset = (16ULL * size + 6 + 2ULL * size + VRING_ALIGN - 1) & ~(uint64_t)(VRING_ALIGN - 1);
+    uint64_t ring_bytes = used_offset + 6 + 8ULL * size;
+    uint64_t ring_phys, req_phys;
+    uint8_t *ring = paging_alloc_dma(ring_bytes, &ring_phys);
+    disk->requests = paging_alloc_dma(sizeof(VirtioBlkRequests), &req_phys);
+    if (!ring || !disk->requests)
+        return -1;
+    disk->requests_phys = req_phys;
+    disk->queue_size = size;
+    disk->desc = ring;
+    disk->avail = ring + 16ULL * size;
+    disk->used = ring + used_offset;
+    VringDesc *desc = disk->desc;
+    for (uint16_t i = 0; i < size; i++)
+        desc[i].next = i + 1;
+    disk->free_head = 0;
+    disk->free_count = size;
+    disk->last_used = disk->avail_shadow = 0;
+    disk->busy = disk->failed = 0;
+    outl(io + VIRTIO_REG_QUEUE_PFN, (uint32_t)(ring_phys / VRING_ALIGN));
+
+    disk->sectors = inl(io + VIRTIO_REG_CONFIG) | ((uint64_t)inl(io + VIRTIO_REG_CONFIG + 4) << 32);
+    disk->irq = 0xFF;
+    if (pci->irq_line < 16 && irq_install(pci->irq_line, virtio_blk_irq, disk) == 0)
+        disk->irq = pci->irq_line;
+    else
+        ((VringAvail *)disk->avail)->flags = VRING_AVAIL_F_NO_INTERRUPT;
+
+    outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+    return 0;
+}
+
+static int virtio_blk_block_read(BlockDevice *block, uint64_t lba, uint32_t count, void *buffer) {
+    return virtio_blk_read(block->driver, lba, count, buffer);
+}
+
+static int virtio_blk_block_write(BlockDevice *block, uint64_t lba, uint32_t count, const void *buffer) {
+    return virtio_blk_write(block->driver, lba, count, buffer);
+}
+
+static int virtio_blk_block_flush(BlockDevice *block) {
+    return virtio_blk_flush(block->driver);
+}
+
+static int virtio_blk_block_submit(BlockDevice *block, uint64_t lba, uint32_t count, void *buffer) {
+    return virtio_blk_submit(block->driver, lba, count, buffer);
+}
+
+// Generic callers submit a batch and then wait, so the kick goes here
+static int virtio_blk_block_wait(BlockDevice *block, uint32_t tags) {
+    virtio_blk_kick(block->driver);
+    return virtio_blk_wait(block->driver, tags);
+}
+
+static const BlockDeviceOps virtio_blk_block_ops = {
+    .read = virtio_blk_block_read,
+    .write = virtio_blk_block_write,
+    .submit = virtio_blk_block_submit,
+    .wait = virtio_blk_block_wait,
+    .flush = virtio_blk_block_flush,
+};
+
+// Disks the host marks read-only register without write and flush
+static const BlockDeviceOps virtio_blk_ro_ops = {
+    .read = virtio_blk_block_read,
+    .submit = virtio_blk_block_submit,
+    .wait = virtio_blk_block_wait,
+};
+
+static void virtio_blk_register(VirtioBlkDisk *disk, int index) {
+    BlockDevice *block = &disk->block;
+    str_copy(block->name, "vda", BLOCK_NAME_LEN);
+    block->name[2] += index;
+    block->ops = disk->read_only ? &virtio_blk_ro_ops : &virtio_blk_block_ops;
+    block->driver = disk;
+    block->block_size = 512;
+    block->blocks = disk->sectors;
+    block->max_request = VIRTIO_BLK_MAX_SECTORS;
+    block->kind = "virtio";
+    block->model = NULL;
+    block_register(block);
+}
+
+int virtio_blk_init(void) {
+    virtio_count = 0;
+    for (int nth = 0; virtio_count < VIRTIO_BLK_MAX_DISKS; nth++) {
+        const PciDevice *pci = pci_find_device(VIRTIO_VENDOR_ID, VIRTIO_BLK_LEGACY_ID, nth);
+        if (!pci)
+            break;
+        VirtioBlkDisk *disk = &virtio_disks[virtio_count];
+        disk->present = 0;
+        if (virtio_blk_setup(disk, pci) < 0)
+            continue;
+        disk->present = 1;
+        virtio_blk_register(disk, virtio_count);
+        virtio_count++;
+    }
+    return virtio_count;
+}
+
+VirtioBlkDisk* virtio_blk_get_disk(int index) {
+    if (index < 0 || index >= virtio_count)
+        return NULL;
+    return &virtio_disks[index];
+}
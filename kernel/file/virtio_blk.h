@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include "block.h"
+
+#define VIRTIO_BLK_MAX_DISKS    2
+#define VIRTIO_BLK_MAX_REQUESTS 32   // in flight per disk (tags)
+#define VIRTIO_BLK_MAX_SECTORS  256  // per request; virtio_blk_read splits larger ones
+
+typedef struct {
+    uint8_t  present;
+    uint8_t  irq;                // PIC line, 0xFF if completion is polled
+    uint8_t  read_only;          // host offers VIRTIO_BLK_F_RO
+    uint8_t  flush;              // VIRTIO_BLK_F_FLUSH negotiated
+    uint16_t io;                 // legacy register block (BAR0)
+    uint16_t queue_size;
+    uint16_t free_head;          // first free descriptor, chained through next
+    uint16_t free_count;
+    uint16_t last_used;          // used ring entries consumed so far
+    uint16_t avail_shadow;       // avail->idx including unkicked requests
+    uint64_t sectors;            // capacity in 512-byte sectors
+    void     *desc;              // descriptor table, then avail ring; used ring on the next page
+    void     *avail;
+    void     *used;
+    void     *requests;          // per-tag header and status byte (DMA)
+    uint64_t requests_phys;
+    uint16_t head_of[VIRTIO_BLK_MAX_REQUESTS];
+    volatile uint32_t busy;      // tags still owned by the device
+    volatile uint32_t failed;    // finished tags whose request failed
+    BlockDevice block;           // registered as vda, vdb
+} VirtioBlkDisk;
+
+// Finds virtio-blk PCI functions (call pci_init first), negotiates the
+// legacy interface, sets up request queue 0 and registers each disk as a
+// block device. Returns the number of disks.
+int virtio_blk_init(void);
+
+VirtioBlkDisk* virtio_blk_get_disk(int index);
+
+// Places a read of at most VIRTIO_BLK_MAX_SECTORS in the ring without telling
+// the device; several submissions share one virtio_blk_kick. Returns the
+// request's tag, or -1 if the ring or tag space is full.
+int virtio_blk_submit(VirtioBlkDisk *disk, uint64_t lba, uint32_t count, void *buffer);
+
+// Publishes every submitted request and notifies the device once
+void virtio_blk_kick(VirtioBlkDisk *disk);
+
+// Sleeps until every tag in `tags` completes (polls before interrupts are on).
+// Returns 0, or -1 if any of them failed.
+int virtio_blk_wait(VirtioBlkDisk *disk, uint32_t tags);
+
+// Reads `count` sectors as one batch of requests. Returns 0 or -1.
+int virtio_blk_read(VirtioBlkDisk *disk, uint64_t lba, uint32_t count, void *buffer);
+
+// Writes `count` sectors as one batch of requests. Returns 0 or -1.
+int virtio_blk_write(VirtioBlkDisk *disk, uint64_t lba, uint32_t count, const void *buffer);
+
+// Commits the host's write cache. Returns 0 or -1.
+int virtio_blk_flush(VirtioBlkDisk *disk);
@@ -6,6 +6,21 @@
 static struct IDTEntry idt[IDT_SIZE];
 
 extern void keyboard_isr(); // from ASM stub
+extern uint64_t irq_stub_table[16];
+
+#define IRQ_VECTOR_BASE   0x20  // after the PIC remap
+#define IRQ_MAX_HANDLERS  4     // per line; PCI lines are shared
+
+typedef struct {
+    IrqHandler fn;
+    void* arg;
+} IrqSlot;
+
+static IrqSlot irq_handlers[16][IRQ_MAX_HANDLERS];
+// Keyboard (IRQ1), the cascade (IRQ2) and the IDE channels (IRQ14/15) are
+// always open; irq_install adds the lines of PCI devices
+static uint16_t irq_unmasked = (1 << 1) | (1 << 2) | (1 << 14) | (1 << 15);
+static int pic_ready = 0;
 
 static inline void outb(uint16_t port, uint8_t value) {
     __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
@@ -28,6 +43,40 @@ void idt_load() {
 
     __asm__ volatile("lidt %0" : : "m"(idtp));
 }
+static void pic_write_masks(void) {
+    outb(0x21, (uint8_t)~irq_unmasked);
+    outb(0xA1, (uint8_t)~(irq_unmasked >> 8));
+}
+
+// Runs from the generic stubs: every handler on the line gets a look, since
+// level-triggered PCI interrupts may be shared
+void irq_dispatch_c(uint64_t irq) {
+    for (int i = 0; i < IRQ_MAX_HANDLERS; i++)
+        if (irq_handlers[irq][i].fn)
+            irq_handlers[irq][i].fn(irq_handlers[irq][i].arg);
+    if (irq >= 8)
+        outb(0xA0, 0x20);
+    outb(0x20, 0x20);
+}
+
+int irq_install(uint8_t irq, IrqHandler fn, void* arg) {
+    if (irq >= 16 || irq == 1 || irq == 2 || irq == 14 || irq == 15)
+        return -1;  // reserved for the dedicated stubs
+    for (int i = 0; i < IRQ_MAX_HANDLERS; i++) {
+        if (irq_handlers[irq][i].fn)
+            continue;
+        irq_handlers[irq][i].arg = arg;
+        irq_handlers[irq][i].fn = fn;
+        idt_set_gate(IRQ_VECTOR_BASE + irq, irq_stub_table[irq]);
+        idt_load();
+        irq_unmasked |= 1 << irq;
+        if (pic_ready)
+            pic_write_masks();
+        return 0;
+    }
+    return -1;
+}
+
 void interrupts_init(void) {
     // === Set keyboard interrupt gate (IRQ1 = vector 0x21) ===
     idt_set_gate(0x21, (uint64_t)keyboard_isr);
@@ -47,9 +96,9 @@ void interrupts_init(void) {
     outb(0x21, 0xFF);
     outb(0xA1, 0xFF);
 
-    // === Unmask only keyboard (IRQ1) ===
-    // IRQ1 corresponds to bit 1 (0xFD = 1111 1101)
-    outb(0x21, 0xFD);
+    // === Unmask the keyboard, the cascade, IDE and any installed lines ===
+    pic_write_masks();
+    pic_ready = 1;
 
     // === Enable interrupts globally ===
     __asm__ volatile ("sti");
@@ -29,6 +29,12 @@ void idt_set_gate(int n, uint64_t handler);
 void idt_load(void);
 void interrupts_init(void);
 
+// Shared handlers for PIC lines without a dedicated stub (PCI INTx).
+// Handlers run with interrupts off; the EOI is sent after all of them.
+typedef void (*IrqHandler)(void* arg);
+int irq_install(uint8_t irq, IrqHandler fn, void* arg);
+void irq_dispatch_c(uint64_t irq);  // called by the ASM stubs
+
 // GDT setup
 void gdt_init(void);
 
@@ -0,0 +1,74 @@
+[BITS 64]
+global irq_stub_table
+extern irq_dispatch_c
+
+; One entry per PIC line; each records its IRQ number and shares the body
+%macro IRQ_STUB 1
+irq_stub_%1:
+    push rdi
+    mov rdi, %1
+    jmp irq_common
+%endmacro
+
+IRQ_STUB 0
+IRQ_STUB 1
+IRQ_STUB 2
+IRQ_STUB 3
+IRQ_STUB 4
+IRQ_STUB 5
+IRQ_STUB 6
+IRQ_STUB 7
+IRQ_STUB 8
+IRQ_STUB 9
+IRQ_STUB 10
+IRQ_STUB 11
+IRQ_STUB 12
+IRQ_STUB 13
+IRQ_STUB 14
+IRQ_STUB 15
+
+irq_common:
+    push rax
+    push rcx
+    push rdx
+    push rsi
+    push r8
+    push r9
+    push r10
+    push r11                  ; 9 pushes on the 40-byte frame: stack is 16-byte aligned
+
+    call irq_dispatch_c       ; IRQ number in RDI, sends the EOI itself
+
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rsi
+    pop rdx
+    pop rcx
+    pop rax
+    pop rdi
+    iretq
+
+section .data
+%macro IRQ_ENTRY 1
+    dq irq_stub_%1
+%endmacro
+
+irq_stub_table:
+IRQ_ENTRY 0
+IRQ_ENTRY 1
+IRQ_ENTRY 2
+IRQ_ENTRY 3
+IRQ_ENTRY 4
+IRQ_ENTRY 5
+IRQ_ENTRY 6
+IRQ_ENTRY 7
+IRQ_ENTRY 8
+IRQ_ENTRY 9
+IRQ_ENTRY 10
+IRQ_ENTRY 11
+IRQ_ENTRY 12
+IRQ_ENTRY 13
+IRQ_ENTRY 14
+IRQ_ENTRY 15
@@ -3,6 +3,10 @@
 #include "screen/vga.h"
 #include "keyboard/keyboard.h"
 #include "file/fat32.h"
+#include "file/disk.h"
+#include "file/ahci.h"
+#include "file/virtio_blk.h"
+#include "pci/pci.h"
 #include "user/console.h"
 #include "user/application.h"
 #include "memory/memory.h" 
@@ -20,7 +24,8 @@ __attribute__((noreturn))
 void kernel_main(void) {
     fb_init(multiboot_info_ptr);
     memory_init(multiboot_info_ptr);
-    paging_map_heap();
+    paging_init();
+    percpu_init(0);  // BSP; the allocator's per-CPU caches are keyed by this_cpu()
     memory_buddy_init();
 
     Window* fullscreen = malloc(sizeof(Window));
@@ -70,9 +75,20 @@ void kernel_main(void) {
     }
     apps[0].window = fullscreen;
 
-    // Initialize disk
-    uint32_t partition_lba_start = find_fat32_partition();
-    if (fat32_init(partition_lba_start))
+    // Initialize disks: each driver registers what it finds as block
+    // devices, fastest interfaces first, and the first FAT32 volume mounts
+    pci_init();
+    virtio_blk_init();
+    ahci_init();
+    ata_init();
+    if (!block_count())
+        fb_write_ansi(fullscreen, "\033[31mERROR\033[0m No disk found.\n");
+    int mounted = 0;
+    for (int i = 0; i < block_count() && !mounted; i++) {
+        BlockDevice *dev = block_get(i);
+        mounted = fat32_init(dev, find_fat32_partition(dev)) == 0;
+    }
+    if (!mounted)
         fb_write_ansi(fullscreen, "\033[31mERROR\033[0m Cannot mount FAT32 volume.\n");
 
     // Initialize events
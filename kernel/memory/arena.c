@@ -0,0 +1,24 @@
+#include "arena.h"
+#include "dynamic.h"
+
+int arena_init(Arena* arena, size_t size) {
+    arena->used = 0;
+    arena->base = malloc(size);
+    arena->size = arena->base ? size : 0;
+    return arena->base ? 0 : -1;
+}
+
+void arena_destroy(Arena* arena) {
+    free(arena->base);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size_t start = (arena->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (!arena->base || start > arena->size || size > arena->size - start)
+        return NULL;
+    arena->used = start + size;
+    return arena->base + start;
+}
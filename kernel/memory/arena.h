@@ -0,0 +1,39 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Scratch arena
+ *  -------------
+ *  One heap block taken once and handed out by bumping an offset. Nothing
+ *  is freed individually: callers take a mark before a unit of work and
+ *  release back to it afterwards, so steady-state use never touches malloc.
+ */
+#define ARENA_ALIGN 8  // same guarantee as malloc
+
+typedef struct {
+    uint8_t* base;
+    size_t   size;
+    size_t   used;
+} Arena;
+
+int   arena_init(Arena* arena, size_t size);  // 0 on success, -1 if the backing block cannot be allocated
+void  arena_destroy(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size); // NULL when the arena is full
+
+static inline size_t arena_mark(const Arena* arena) {
+    return arena->used;
+}
+
+static inline void arena_release(Arena* arena, size_t mark) {
+    if (mark < arena->used)
+        arena->used = mark;
+}
+
+#ifdef __cplusplus
+}
+#endif
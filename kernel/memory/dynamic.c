@@ -1,5 +1,9 @@
 #include "dynamic.h"
+#include "slab.h"
+#include "paging.h"
 #include "../screen/screen.h"  // optional debug prints
+#include "../smp/smp.h"
+#include "../smp/spinlock.h"
 
 // ==== External heap globals (from memory.c) ====
 extern uint8_t* heap_base;
@@ -7,141 +11,533 @@ extern uint64_t heap_size;
 extern uint64_t heap_used;
 
 // ==== Buddy allocator ====
+// Manages one contiguous, demand-committed virtual range [start, end) that
+// grows at its end (see paging_heap_extend)
 typedef struct {
-    Block* free_list[ORDER_COUNT];
-    int    max_order;  // dynamically determined
+    Block*    free_list[ORDER_COUNT];
+    uint64_t  nonempty;   // bit i set when free_list[i] has blocks
+    uintptr_t start;
+    uintptr_t end;
 } BuddyAllocator;
 
 static BuddyAllocator buddy;
+static MemoryStats stats;  // counters below are updated under heap_lock
 
 #define ALIGN_UP(x, a) (((x) + ((a)-1)) & ~((a)-1))
+#define HEAP_GROW_STEP (1UL << 21)  // reserve address space 2 MiB at a time
+
 static inline uintptr_t buddy_of(uintptr_t addr, int order) {
     return addr ^ (1UL << order);
 }
+
+// ==== Free list helpers (all O(1)) ====
+static inline void free_list_push(Block* block, int order) {
+    int i = order - MIN_ORDER;
+    block->tag = BLOCK_MAGIC | BLOCK_FREE | (uint64_t)order;
+    block->prev = NULL;
+    block->next = buddy.free_list[i];
+    if (block->next)
+        block->next->prev = block;
+    buddy.free_list[i] = block;
+    buddy.nonempty |= (1ULL << i);
+}
+
+static inline void free_list_remove(Block* block, int order) {
+    int i = order - MIN_ORDER;
+    if (block->prev) block->prev->next = block->next;
+    else buddy.free_list[i] = block->next;
+    if (block->next)
+        block->next->prev = block->prev;
+    if (!buddy.free_list[i])
+        buddy.nonempty &= ~(1ULL << i);
+    block->tag = 0;
+}
+
+static inline int block_is_free(uintptr_t addr, int order) {
+    if (addr < buddy.start || addr + (1UL << order) > buddy.end)
+        return 0;
+    return ((Block*)addr)->tag == (BLOCK_MAGIC | BLOCK_FREE | (uint64_t)order);
+}
+
+// Returns a block to the free lists, merging upward while its buddy is free
+static void buddy_release(uintptr_t addr, int order) {
+    while (order < MAX_ORDER) {
+        uintptr_t buddy_addr = buddy_of(addr, order);
+        if (!block_is_free(buddy_addr, order))
+            break;
+        free_list_remove((Block*)buddy_addr, order);
+        addr = (addr < buddy_addr) ? addr : buddy_addr;
+        order++;
+    }
+    free_list_push((Block*)addr, order);
+}
+
+// Carve [start, end) into naturally aligned power-of-two blocks
+static void buddy_add_range(uintptr_t start, uintptr_t end) {
+    while (start + (1UL << MIN_ORDER) <= end) {
+        int order = MIN_ORDER;
+        while (order < MAX_ORDER
+               && !(start & ((1UL << (order + 1)) - 1))
+               && start + (1UL << (order + 1)) <= end)
+            order++;
+        buddy_release(start, order);
+        start += (1UL << order);
+    }
+}
+
+// Extends the heap up to at least `target`. Only address space and a frame
+// budget are taken; pages are committed by the page-fault handler on first touch.
+static int buddy_extend_to(uintptr_t target) {
+    uintptr_t end = buddy.end;
+    size_t need = target - end;
+    size_t want = (need < HEAP_GROW_STEP) ? HEAP_GROW_STEP : need;
+    void* virt = paging_heap_extend(want);
+    if (!virt && want != need)
+        virt = paging_heap_extend(want = need);
+    if (!virt)
+        return 0;
+    buddy.end = end + want;
+    heap_size += want;
+    buddy_add_range(end, buddy.end);
+    return 1;
+}
+
+// Makes room for a naturally aligned block of `block_size` past the current end
+static int buddy_grow(size_t block_size) {
+    return buddy_extend_to(ALIGN_UP(buddy.end, block_size) + block_size);
+}
+
 void memory_buddy_init(void) {
-    uintptr_t addr = (uintptr_t)heap_base;
-    size_t size = heap_size;
-
-    size_t align = (1UL << MIN_ORDER);
-    addr = ALIGN_UP(addr, align);
-    size -= (addr - (uintptr_t)heap_base);
-    size &= ~((align - 1));
-    heap_base = (uint8_t*)addr;
-    heap_size = size;
+    heap_size = 0;
     heap_used = 0;
     for (int i = 0; i < ORDER_COUNT; i++)
         buddy.free_list[i] = NULL;
-    int max_order = MIN_ORDER;
-    while (((1UL << (max_order + 1)) <= heap_size) && (max_order < MAX_ORDER))
-        max_order++;
-    buddy.max_order = max_order;
-    Block* first = (Block*)heap_base;
-    first->next = NULL;
-    buddy.free_list[max_order - MIN_ORDER] = first;
+    buddy.nonempty = 0;
+    buddy.start = buddy.end = HEAP_VIRT_BASE;
+    heap_base = (uint8_t*)buddy.start;
 }
 
 
 // ==== Allocation ====
+// Smallest order whose block holds `size` bytes
 static int order_for_size(size_t size) {
-    int max_order = MIN_ORDER;
-    while (((1UL << (max_order + 1)) <= size) && (max_order < MAX_ORDER))
-        max_order++;
-    return max_order;
+    int order = MIN_ORDER;
+    while (((1UL << order) < size) && (order < MAX_ORDER + 1))
+        order++;
+    return order;
 }
 
-void* malloc(size_t size) {
-    if (size == 0) return NULL;
+// With `headroom`, a block of a higher order is preferred when one is already
+// free, so that the block returned is a lower half whose buddy stays free to
+// grow into. The heap is never grown just for the headroom.
+static void* buddy_alloc_order(int order, int headroom) {
+    uint64_t mask = ~((1ULL << (order - MIN_ORDER)) - 1);
+    uint64_t candidates = buddy.nonempty & (mask << headroom);
+    if (!candidates)
+        candidates = buddy.nonempty & mask;
+    // Lowest non-empty list at or above the requested order, growing the
+    // heap when none is left
+    while (!candidates) {
+        if (!buddy_grow(1UL << order)) return NULL;
+        candidates = buddy.nonempty & mask;
+    }
+    int i = __builtin_ctzll(candidates) + MIN_ORDER;
 
-    int order = order_for_size(size);
-    if (order > buddy.max_order) return NULL;
+    Block* block = buddy.free_list[i - MIN_ORDER];
+    free_list_remove(block, i);
 
-    int i = order - MIN_ORDER;
-    while (i < (buddy.max_order - MIN_ORDER + 1) && buddy.free_list[i] == NULL)
-        i++;
-    if (i >= (buddy.max_order - MIN_ORDER + 1)) return NULL;
-
-    // Split larger blocks until correct size
-    for (; i > order - MIN_ORDER; i--) {
-        Block* block = buddy.free_list[i];
-        buddy.free_list[i] = block->next;
-        uintptr_t addr = (uintptr_t)block;
-        size_t half = 1UL << (i + MIN_ORDER - 1);
-        Block* b1 = (Block*)addr;
-        Block* b2 = (Block*)(addr + half);
-        b1->next = b2;
-        b2->next = buddy.free_list[i - 1];
-        buddy.free_list[i - 1] = b1;
-    }
-
-    // Allocate from the correct order list
-    Block* alloc = buddy.free_list[order - MIN_ORDER];
-    buddy.free_list[order - MIN_ORDER] = alloc->next;
+    // Split down to the requested order, returning upper halves to the lists
+    while (i > order) {
+        i--;
+        free_list_push((Block*)((uintptr_t)block + (1UL << i)), i);
+    }
 
     heap_used += (1UL << order);
+    if (heap_used > stats.peak_used)
+        stats.peak_used = heap_used;
+    stats.allocs[order - MIN_ORDER]++;
+    stats.live[order - MIN_ORDER]++;
 
-    uint64_t* header = (uint64_t*)alloc;
-    *header = order;
+    uint64_t* header = (uint64_t*)block;
+    *header = BLOCK_MAGIC | (uint64_t)order;
     return (void*)(header + 1);
 }
 
+void* buddy_malloc(size_t size) {
+    if (size == 0) return NULL;
+    int order = order_for_size(size + sizeof(uint64_t));  // header lives in the block
+    if (order > MAX_ORDER) return NULL;
+    return buddy_alloc_order(order, 0);
+}
+
 // ==== Free ====
-void free(void* ptr) {
+void buddy_free(void* ptr) {
     if (!ptr) return;
 
     uint64_t* header = (uint64_t*)ptr - 1;
-    int order = (int)*header;
+    if ((*header & (BLOCK_MAGIC_MASK | BLOCK_FREE)) != BLOCK_MAGIC)
+        return;  // double free or foreign pointer: ignore rather than corrupt lists
+    int order = block_order(*header);
     uintptr_t addr = (uintptr_t)header;
 
     heap_used -= (1UL << order);
+    stats.live[order - MIN_ORDER]--;
 
-    while (order <= buddy.max_order) {
-        uintptr_t buddy_addr = buddy_of(addr, order);
-        Block** list = &buddy.free_list[order - MIN_ORDER];
-        Block* prev = NULL;
-        Block* curr = *list;
-
-        while (curr) {
-            if ((uintptr_t)curr == buddy_addr) {
-                // Found buddy — remove it and merge
-                if (prev) prev->next = curr->next;
-                else *list = curr->next;
-                addr = (addr < buddy_addr) ? addr : buddy_addr;
-                order++;
-                goto merge_again;
-            }
-            prev = curr;
-            curr = curr->next;
+    buddy_release(addr, order);
+}
+
+// ==== Per-CPU magazines ====
+// Each CPU keeps a small stack of free objects per slab class and only takes
+// the heap lock to refill or spill half a magazine at a time.
+#define MAGAZINE_SIZE 32
+
+typedef struct {
+    uint32_t count;
+    void*    objs[MAGAZINE_SIZE];
+} Magazine;
+
+typedef struct {
+    Magazine mags[SLAB_CLASS_COUNT];
+} CpuCache;
+
+static Spinlock heap_lock = SPINLOCK_INIT;  // guards the buddy core and the slab layer
+static CpuCache cpu_caches[MAX_CPUS];
+
+static void* cache_alloc(int c) {
+    uint64_t flags = irq_save();
+    Magazine* mag = &cpu_caches[this_cpu()].mags[c];
+    if (!mag->count) {
+        spin_lock(&heap_lock);
+        while (mag->count < MAGAZINE_SIZE / 2) {
+            void* obj = slab_alloc_class(c);
+            if (!obj) break;
+            mag->objs[mag->count++] = obj;
         }
+        spin_unlock(&heap_lock);
+    }
+    void* ptr = mag->count ? mag->objs[--mag->count] : NULL;
+    irq_restore(flags);
+    return ptr;
+}
 
-        // No buddy found — add this block
-        Block* block = (Block*)addr;
-        block->next = *list;
-        *list = block;
-        return;
+static void cache_free(void* ptr, int c) {
+    uint64_t flags = irq_save();
+    Magazine* mag = &cpu_caches[this_cpu()].mags[c];
+    if (mag->count == MAGAZINE_SIZE) {
+        spin_lock(&heap_lock);
+        while (mag->count > MAGAZINE_SIZE / 2)
+            slab_free(mag->objs[--mag->count]);
+        spin_unlock(&heap_lock);
+    }
+    mag->objs[mag->count++] = ptr;
+    irq_restore(flags);
+}
+
+void memory_flush_caches(void) {
+    uint64_t flags = irq_save();
+    CpuCache* cache = &cpu_caches[this_cpu()];
+    spin_lock(&heap_lock);
+    for (int c = 0; c < SLAB_CLASS_COUNT; c++)
+        while (cache->mags[c].count)
+            slab_free(cache->mags[c].objs[--cache->mags[c].count]);
+    spin_unlock(&heap_lock);
+    irq_restore(flags);
+}
+
+static void* locked_buddy_malloc(size_t size) {
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    void* ptr = buddy_malloc(size);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ptr;
+}
+
+// ==== Slab for small objects, buddy otherwise ====
+static void* heap_alloc(size_t size) {
+    if (size == 0) return NULL;
+    if (size <= SLAB_MAX_SIZE) {
+        void* ptr = cache_alloc(slab_class_index(size));
+        if (ptr) return ptr;
+    }
+    void* ptr = locked_buddy_malloc(size);
+    if (!ptr) {
+        // Objects parked in this CPU's magazines may be pinning whole pages
+        memory_flush_caches();
+        ptr = locked_buddy_malloc(size);
+    }
+    return ptr;
+}
 
-    merge_again: ;
+static void heap_free(void* ptr) {
+    if (!ptr) return;
+    if (slab_owns(ptr)) {
+        int c = slab_class_of(ptr);
+        if (c >= 0) cache_free(ptr, c);
+        return;
     }
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    buddy_free(ptr);
+    spin_unlock_irqrestore(&heap_lock, flags);
 }
 
 // ==== Reallocation ====
-void* realloc(void* ptr, size_t new_size) {
-    if (!ptr) return malloc(new_size);
-    if (new_size == 0) { free(ptr); return NULL; }
-
+// Resizes a buddy block without moving it (caller holds heap_lock). Shrinking
+// splits off upper halves; growing absorbs the free buddies above the block,
+// which only works while the block is the lower half at every order.
+static int buddy_resize_in_place(void* ptr, size_t new_size) {
     uint64_t* header = (uint64_t*)ptr - 1;
-    int old_order = (int)*header;
-    size_t old_size = (1UL << old_order) - sizeof(uint64_t);
+    if ((*header & (BLOCK_MAGIC_MASK | BLOCK_FREE)) != BLOCK_MAGIC)
+        return 0;
+    uintptr_t addr = (uintptr_t)header;
+    int order = block_order(*header);
+    int new_order = order_for_size(new_size + sizeof(uint64_t));
+    if (new_order > MAX_ORDER)
+        return 0;
+
+    if (new_order < order) {
+        for (int i = order - 1; i >= new_order; i--) {
+            heap_used -= (1UL << i);
+            buddy_release(addr + (1UL << i), i);
+        }
+    } else if (new_order > order) {
+        // A block at the end of the heap can grow into fresh address space
+        uintptr_t new_end = addr + (1UL << new_order);
+        if (!(addr & ((1UL << new_order) - 1)) && new_end > buddy.end)
+            buddy_extend_to(new_end);
+        for (int i = order; i < new_order; i++)
+            if ((addr & ((1UL << (i + 1)) - 1)) || !block_is_free(addr + (1UL << i), i))
+                return 0;
+        for (int i = order; i < new_order; i++) {
+            free_list_remove((Block*)(addr + (1UL << i)), i);
+            heap_used += (1UL << i);
+        }
+        if (heap_used > stats.peak_used)
+            stats.peak_used = heap_used;
+    }
+    stats.live[order - MIN_ORDER]--;
+    stats.live[new_order - MIN_ORDER]++;
+    *header = BLOCK_MAGIC | (uint64_t)new_order;
+    return 1;
+}
 
-    if (new_size <= old_size) return ptr;
-    void* new_ptr = malloc(new_size);
+static void* heap_realloc(void* ptr, size_t new_size) {
+    if (!ptr) return heap_alloc(new_size);
+    if (new_size == 0) { heap_free(ptr); return NULL; }
+
+    size_t old_size;
+    if (slab_owns(ptr)) {
+        old_size = slab_object_size(ptr);
+        if (new_size <= old_size) return ptr;
+    } else {
+        uint64_t* header = (uint64_t*)ptr - 1;
+        old_size = (1UL << block_order(*header)) - sizeof(uint64_t);
+        if (new_size <= old_size && new_size > old_size / 2) return ptr;  // same order
+        uint64_t flags = spin_lock_irqsave(&heap_lock);
+        int resized = buddy_resize_in_place(ptr, new_size);
+        spin_unlock_irqrestore(&heap_lock, flags);
+        if (resized) return ptr;
+    }
+
+    // Moving anyway: land where the next growth can happen in place
+    void* new_ptr = NULL;
+    if (new_size > SLAB_MAX_SIZE) {
+        int order = order_for_size(new_size + sizeof(uint64_t));
+        if (order <= MAX_ORDER) {
+            uint64_t flags = spin_lock_irqsave(&heap_lock);
+            new_ptr = buddy_alloc_order(order, 1);
+            spin_unlock_irqrestore(&heap_lock, flags);
+        }
+    }
+    if (!new_ptr) new_ptr = heap_alloc(new_size);
     if (!new_ptr) return NULL;
 
-    uint8_t* src = (uint8_t*)ptr;
-    uint8_t* dst = (uint8_t*)new_ptr;
-    for (size_t i = 0; i < old_size; i++)
+    size_t n = (old_size < new_size) ? old_size : new_size;
+    uint64_t* src = (uint64_t*)ptr;  // both sides are 8-byte aligned
+    uint64_t* dst = (uint64_t*)new_ptr;
+    for (size_t i = 0; i < n / sizeof(uint64_t); i++)
         dst[i] = src[i];
+    for (size_t i = n & ~(sizeof(uint64_t) - 1); i < n; i++)
+        ((uint8_t*)new_ptr)[i] = ((uint8_t*)ptr)[i];
 
-    free(ptr);
+    heap_free(ptr);
+    return new_ptr;
+}
+
+// ==== Caller tracing ====
+// Open-addressed table (linear probing, backward-shift deletion) from live
+// pointer to the code that allocated it. Off until memory_trace(1).
+#if MEMORY_TRACE_CALLERS
+typedef struct {
+    void*  ptr;
+    void*  caller;
+    size_t size;
+} TraceEntry;
+
+static TraceEntry trace_table[MEMORY_TRACE_SLOTS];
+static Spinlock   trace_lock = SPINLOCK_INIT;
+static volatile int trace_enabled = 0;
+static size_t     trace_count = 0;
+static uint64_t   trace_dropped = 0;  // allocations not recorded because the table was full
+
+#define TRACE_MAX_LOAD (MEMORY_TRACE_SLOTS / 4 * 3)  // keeps probe runs short
+
+static inline size_t trace_slot(const void* ptr) {
+    uint64_t h = (uint64_t)ptr * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h >> 32) & (MEMORY_TRACE_SLOTS - 1);
+}
+
+static void trace_record(void* ptr, void* caller, size_t size) {
+    if (!trace_enabled) return;
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    size_t i = trace_slot(ptr);
+    for (size_t n = 0; n < MEMORY_TRACE_SLOTS; n++, i = (i + 1) & (MEMORY_TRACE_SLOTS - 1)) {
+        if (!trace_table[i].ptr && trace_count >= TRACE_MAX_LOAD)
+            break;
+        if (!trace_table[i].ptr || trace_table[i].ptr == ptr) {
+            if (!trace_table[i].ptr)
+                trace_count++;
+            trace_table[i].ptr = ptr;
+            trace_table[i].caller = caller;
+            trace_table[i].size = size;
+            spin_unlock_irqrestore(&trace_lock, flags);
+            return;
+        }
+    }
+    trace_dropped++;
+    spin_unlock_irqrestore(&trace_lock, flags);
+}
+
+static void trace_forget(void* ptr) {
+    if (!trace_enabled || !ptr) return;
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    size_t i = trace_slot(ptr);
+    for (size_t n = 0; n < MEMORY_TRACE_SLOTS && trace_table[i].ptr && trace_table[i].ptr != ptr; n++)
+        i = (i + 1) & (MEMORY_TRACE_SLOTS - 1);
+    if (trace_table[i].ptr == ptr) {
+        // Shift later entries of the same probe run back into the hole
+        size_t hole = i;
+        for (size_t j = (i + 1) & (MEMORY_TRACE_SLOTS - 1); trace_table[j].ptr;
+             j = (j + 1) & (MEMORY_TRACE_SLOTS - 1)) {
+            size_t home = trace_slot(trace_table[j].ptr);
+            if (((j - home) & (MEMORY_TRACE_SLOTS - 1)) >= ((j - hole) & (MEMORY_TRACE_SLOTS - 1))) {
+                trace_table[hole] = trace_table[j];
+                hole = j;
+            }
+        }
+        trace_table[hole].ptr = NULL;
+        trace_count--;
+    }
+    spin_unlock_irqrestore(&trace_lock, flags);
+}
+
+uint64_t memory_trace_dropped(void) {
+    return trace_dropped;
+}
+
+int memory_trace(int enable) {
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    if (enable && !trace_enabled) {
+        for (size_t i = 0; i < MEMORY_TRACE_SLOTS; i++)
+            trace_table[i].ptr = NULL;
+        trace_count = 0;
+        trace_dropped = 0;
+    }
+    trace_enabled = enable;
+    spin_unlock_irqrestore(&trace_lock, flags);
+    return 1;
+}
+
+// Sums live traced blocks per caller into `out` (at most `max` callers,
+// largest first). Returns the number of entries written.
+size_t memory_trace_callers(MemoryCaller* out, size_t max) {
+    size_t count = 0;
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    for (size_t i = 0; i < MEMORY_TRACE_SLOTS; i++) {
+        if (!trace_table[i].ptr) continue;
+        size_t k = 0;
+        while (k < count && out[k].caller != trace_table[i].caller) k++;
+        if (k == count) {
+            if (count == max) continue;  // table of callers is full
+            out[count].caller = trace_table[i].caller;
+            out[count].blocks = 0;
+            out[count].bytes = 0;
+            count++;
+        }
+        out[k].blocks++;
+        out[k].bytes += trace_table[i].size;
+    }
+    spin_unlock_irqrestore(&trace_lock, flags);
+    for (size_t i = 1; i < count; i++) {
+        MemoryCaller c = out[i];
+        size_t j = i;
+        for (; j > 0 && out[j - 1].bytes < c.bytes; j--)
+            out[j] = out[j - 1];
+        out[j] = c;
+    }
+    return count;
+}
+#else
+static inline void trace_record(void* ptr, void* caller, size_t size) { (void)ptr; (void)caller; (void)size; }
+static inline void trace_forget(void* ptr) { (void)ptr; }
+int memory_trace(int enable) { (void)enable; return 0; }
+uint64_t memory_trace_dropped(void) { return 0; }
+size_t memory_trace_callers(MemoryCaller* out, size_t max) { (void)out; (void)max; return 0; }
+#endif
+
+// ==== Reclaim ====
+// Caches that can give memory back register here. An allocation that would
+// fail asks them for the bytes it needs and is retried once.
+static MemoryReclaimer reclaimers[MEMORY_MAX_RECLAIMERS];
+static int reclaimer_count = 0;
+static int reclaiming = 0;
+
+int memory_add_reclaimer(MemoryReclaimer fn) {
+    if (reclaimer_count >= MEMORY_MAX_RECLAIMERS)
+        return -1;
+    reclaimers[reclaimer_count++] = fn;
+    return 0;
+}
+
+static int memory_reclaim(size_t size) {
+    // Allocations made by a reclaimer itself must not recurse into it
+    if (__atomic_exchange_n(&reclaiming, 1, __ATOMIC_ACQUIRE))
+        return 0;
+    size_t freed = 0;
+    for (int i = 0; i < reclaimer_count && freed < size; i++)
+        freed += reclaimers[i](size - freed);
+    __atomic_store_n(&reclaiming, 0, __ATOMIC_RELEASE);
+    return freed != 0;
+}
+
+// ==== Public entry points ====
+void* malloc(size_t size) {
+    void* ptr = heap_alloc(size);
+    if (!ptr && size && memory_reclaim(size))
+        ptr = heap_alloc(size);
+    if (!ptr) {
+        if (size) __atomic_add_fetch(&stats.failed, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    trace_record(ptr, __builtin_return_address(0), size);
+    return ptr;
+}
+
+void free(void* ptr) {
+    if (!ptr) return;
+    trace_forget(ptr);
+    heap_free(ptr);
+}
+
+void* realloc(void* ptr, size_t new_size) {
+    void* new_ptr = heap_realloc(ptr, new_size);
+    if (!new_ptr && new_size && memory_reclaim(new_size))
+        new_ptr = heap_realloc(ptr, new_size);
+    if (!new_ptr) {
+        if (new_size) __atomic_add_fetch(&stats.failed, 1, __ATOMIC_RELAXED);
+        else trace_forget(ptr);
+        return NULL;
+    }
+    if (ptr && new_ptr != ptr) trace_forget(ptr);
+    trace_record(new_ptr, __builtin_return_address(0), new_size);
     return new_ptr;
 }
 
@@ -150,6 +546,19 @@ uint64_t memory_used(void) {
     return heap_used;
 }
 
+void memory_get_stats(MemoryStats* out) {
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    *out = stats;
+    spin_unlock_irqrestore(&heap_lock, flags);
+    for (int c = 0; c < SLAB_CLASS_COUNT; c++) {
+        uint64_t cached = 0;
+        for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+            cached += cpu_caches[cpu].mags[c].count;
+        out->slab_cached[c] = cached;
+        out->slab_live[c] = slab_class_live(c) - cached;
+    }
+}
+
 uint64_t memory_total(void) {
     return heap_size;
 }
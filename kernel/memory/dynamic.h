@@ -10,19 +10,77 @@ extern "C" {
 #define MAX_ORDER 42  // 1TB theoretical max, dynamically limited
 #define ORDER_COUNT (MAX_ORDER - MIN_ORDER + 1)
 
+/*
+ * Every block starts with a 64-bit tag: magic | free flag | order.
+ * Allocated blocks keep only the tag (the user pointer follows it),
+ * free blocks additionally link into a doubly linked per-order list.
+ * Reading the tag at a buddy's address tells in O(1) whether it can merge.
+ */
+#define BLOCK_MAGIC      0xB0DD000000000000ULL
+#define BLOCK_MAGIC_MASK 0xFFFF000000000000ULL
+#define BLOCK_FREE       0x100ULL
+#define BLOCK_ORDER_MASK 0xFFULL
+
 typedef struct Block {
+    uint64_t tag;
     struct Block* next;
+    struct Block* prev;
 } Block;
 
+static inline int block_order(uint64_t tag) {
+    return (int)(tag & BLOCK_ORDER_MASK);
+}
+
 /* Core API */
 void memory_buddy_init(void);
 void* malloc(size_t size);
 void free(void* ptr);
 void* realloc(void* ptr, size_t new_size);
 
+/* Buddy core: page-granular blocks with an 8-byte order header (used by the
+ * slab layer, callers hold the heap lock) */
+void* buddy_malloc(size_t size);
+void buddy_free(void* ptr);
+
+/* Set to 0 to compile out per-block caller tracing */
+#ifndef MEMORY_TRACE_CALLERS
+#define MEMORY_TRACE_CALLERS 1
+#endif
+#define MEMORY_TRACE_SLOTS 4096  // live blocks that can be traced at once (power of two)
+
+#define MEMORY_SLAB_CLASSES 9    // size classes of the slab layer (slab.h)
+
+typedef struct {
+    uint64_t allocs[ORDER_COUNT];  // buddy blocks handed out per order since boot
+    uint64_t live[ORDER_COUNT];    // buddy blocks currently allocated per order
+    uint64_t peak_used;            // high-water mark of memory_used()
+    uint64_t failed;               // malloc/realloc calls that returned NULL
+    uint64_t slab_live[MEMORY_SLAB_CLASSES];    // small objects in use per class
+    uint64_t slab_cached[MEMORY_SLAB_CLASSES];  // free objects parked in per-CPU magazines
+} MemoryStats;
+
+typedef struct {
+    void*    caller;
+    uint64_t blocks;
+    uint64_t bytes;   // requested sizes, not block sizes
+} MemoryCaller;
+
+void memory_get_stats(MemoryStats* out);
+int memory_trace(int enable);  // 0 when tracing is compiled out
+size_t memory_trace_callers(MemoryCaller* out, size_t max);
+uint64_t memory_trace_dropped(void);  // allocations missed because the table was full
+
+/* Memory pressure: a reclaimer frees about `wanted` bytes of cached data if
+ * it can and returns how much it freed. Called when malloc/realloc would
+ * fail, before giving up. Returns -1 if the table is full. */
+#define MEMORY_MAX_RECLAIMERS 4
+typedef size_t (*MemoryReclaimer)(size_t wanted);
+int memory_add_reclaimer(MemoryReclaimer fn);
+
 /* Info helpers */
 uint64_t memory_used(void);
 uint64_t memory_total(void);
+void memory_flush_caches(void);  // return this CPU's cached objects to the shared heap
 
 #ifdef __cplusplus
 }
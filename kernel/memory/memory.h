@@ -1,3 +1,5 @@
 #include "region.h"
 #include "paging.h"
-#include "dynamic.h"
\ No newline at end of file
+#include "dynamic.h"
+#include "slab.h"
+#include "arena.h"
@@ -0,0 +1,36 @@
+[BITS 64]
+global page_fault_isr
+extern page_fault_handler_c
+
+page_fault_isr:
+    ; === CPU pushed SS, RSP, RFLAGS, CS, RIP and an error code ===
+    push rax
+    push rcx
+    push rdx
+    push rsi
+    push rdi
+    push r8
+    push r9
+    push r10
+    push r11
+
+    mov rdi, cr2              ; faulting address (1st argument)
+    mov rsi, [rsp + 9*8]      ; error code (2nd argument)
+    mov rdx, [rsp + 10*8]     ; faulting RIP (3rd argument)
+    sub rsp, 8                ; align stack to 16 bytes (SysV ABI requires it)
+    call page_fault_handler_c
+    add rsp, 8
+
+    ; === Restore registers ===
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rdi
+    pop rsi
+    pop rdx
+    pop rcx
+    pop rax
+
+    add rsp, 8                ; drop the error code
+    iretq
@@ -1,32 +1,278 @@
 #include <stdint.h>
 #include "../screen/screen.h"
+#include "../interrupts.h"
+#include "../smp/spinlock.h"
 #include "region.h"
 #include "paging.h"
 
-extern uint64_t pd_table_heap[];
-extern uint8_t* heap_base;
-extern uint64_t heap_size;
-extern uint64_t heap_used;
-
 extern uint64_t pml4_table[];
+extern void page_fault_isr(); // from ASM stub
 uint64_t kernel_pml4 = 0;
 
-#define HEAP_VIRT_BASE 0x40000000ULL  // map heap here
+#define PAGE_FRAME_MASK 0x000FFFFFFFFFF000ULL
+
+static uint64_t heap_reserved_end = HEAP_VIRT_BASE;  // [HEAP_VIRT_BASE, end) may be touched
+static uint64_t heap_committed = 0;                  // bytes actually backed by frames
+static uint64_t device_window_end = DEVICE_VIRT_BASE; // next free page of the device window
+static uint64_t map_window_end = MAP_VIRT_BASE;       // next free page of the mapping window
+static PagingFaultHandler map_fault_handler = NULL;
+static Spinlock paging_lock = SPINLOCK_INIT;         // page-table updates from any CPU
+
+// ==== Recursive mapping ====
+// PML4[PAGING_RECURSIVE_SLOT] points back at the PML4 itself, so the entry
+// mapping any address sits at a fixed virtual address at every level.
+#define RECURSIVE_BASE (0xFFFF000000000000ULL | (PAGING_RECURSIVE_SLOT << 39))
+
+static inline uint64_t* pt_entry(uint64_t virt) {
+    return (uint64_t*)(RECURSIVE_BASE | ((virt >> 9) & 0x7FFFFFFFF8ULL));
+}
+static inline uint64_t* pd_entry(uint64_t virt)   { return pt_entry((uint64_t)pt_entry(virt)); }
+static inline uint64_t* pdpt_entry(uint64_t virt) { return pt_entry((uint64_t)pd_entry(virt)); }
+static inline uint64_t* pml4_entry(uint64_t virt) { return pt_entry((uint64_t)pdpt_entry(virt)); }
+
+static inline uint64_t* table_of(uint64_t* entry) {
+    return (uint64_t*)((uint64_t)entry & ~(PAGE_SIZE_4K - 1));
+}
+
+static inline void invlpg(uint64_t virt) {
+    __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
+}
+
+// Makes `entry` point at a page table, allocating a zeroed frame on first use.
+// `table` is where that table shows up through the recursive slot.
+static int ensure_table(uint64_t* entry, uint64_t* table) {
+    if (*entry & PAGE_PRESENT)
+        return (*entry & PAGE_PS) ? -1 : 0;  // already covered by a large page
+    uint64_t frame = pmm_alloc_frame();
+    if (!frame)
+        return -1;
+    *entry = frame | PAGE_PRESENT | PAGE_RW;
+    invlpg((uint64_t)table);
+    for (int i = 0; i < ENTRIES_PER_TABLE; i++)
+        table[i] = 0;
+    return 0;
+}
+
+// Maps one 4 KiB or 2 MiB page; intermediate tables are created lazily
+static int map_locked(uint64_t virt, uint64_t phys, uint64_t page_size, uint64_t flags) {
+    if (page_size != PAGE_SIZE_4K && page_size != PAGE_SIZE_2M)
+        return -1;
+    if ((virt | phys) & (page_size - 1))
+        return -1;
+    if (ensure_table(pml4_entry(virt), table_of(pdpt_entry(virt))))
+        return -1;
+    if (ensure_table(pdpt_entry(virt), table_of(pd_entry(virt))))
+        return -1;
+    if (page_size == PAGE_SIZE_2M) {
+        *pd_entry(virt) = phys | flags | PAGE_PRESENT | PAGE_PS;
+    } else {
+        if (ensure_table(pd_entry(virt), table_of(pt_entry(virt))))
+            return -1;
+        *pt_entry(virt) = phys | flags | PAGE_PRESENT;
+    }
+    invlpg(virt);
+    return 0;
+}
+
+int paging_map(uint64_t virt, uint64_t phys, uint64_t page_size, uint64_t flags) {
+    uint64_t irq = spin_lock_irqsave(&paging_lock);
+    int result = map_locked(virt, phys, page_size, flags);
+    spin_unlock_irqrestore(&paging_lock, irq);
+    return result;
+}
+
+// Only this CPU's TLB is flushed; the tables themselves stay
+int paging_unmap(uint64_t virt) {
+    int result = -1;
+    uint64_t irq = spin_lock_irqsave(&paging_lock);
+    if ((*pml4_entry(virt) & PAGE_PRESENT)
+            && (*pdpt_entry(virt) & (PAGE_PRESENT | PAGE_PS)) == PAGE_PRESENT
+            && (*pd_entry(virt) & (PAGE_PRESENT | PAGE_PS)) == PAGE_PRESENT
+            && (*pt_entry(virt) & PAGE_PRESENT)) {
+        *pt_entry(virt) = 0;
+        invlpg(virt);
+        result = 0;
+    }
+    spin_unlock_irqrestore(&paging_lock, irq);
+    return result;
+}
+
+uint64_t paging_virt_to_phys(uint64_t virt) {
+    if (!(*pml4_entry(virt) & PAGE_PRESENT))
+        return 0;
+    uint64_t e = *pdpt_entry(virt);
+    if (!(e & PAGE_PRESENT))
+        return 0;
+    if (e & PAGE_PS)
+        return (e & PAGE_FRAME_MASK & ~(PAGE_SIZE_1G - 1)) | (virt & (PAGE_SIZE_1G - 1));
+    e = *pd_entry(virt);
+    if (!(e & PAGE_PRESENT))
+        return 0;
+    if (e & PAGE_PS)
+        return (e & PAGE_FRAME_MASK & ~(PAGE_SIZE_2M - 1)) | (virt & (PAGE_SIZE_2M - 1));
+    e = *pt_entry(virt);
+    if (!(e & PAGE_PRESENT))
+        return 0;
+    return (e & PAGE_FRAME_MASK) | (virt & (PAGE_SIZE_4K - 1));
+}
+
+// ==== Heap window ====
+// Page tables needed to map the first `bytes` of the heap window
+static uint64_t heap_tables_for(uint64_t bytes) {
+    if (!bytes)
+        return 0;
+    return 1 + (bytes + PAGE_SIZE_1G - 1) / PAGE_SIZE_1G
+             + (bytes + PAGE_SIZE_2M - 1) / PAGE_SIZE_2M;
+}
 
-void paging_map_heap(void) {
-    if (!heap_base || heap_size == 0)
+// Reserves `size` more bytes of heap address space right after the previous
+// reservation. Frames (and the tables that map them) are only set aside here;
+// they get mapped by the page-fault handler when the memory is first touched.
+void* paging_heap_extend(uint64_t size) {
+    size = (size + PAGE_SIZE_4K - 1) & ~(PAGE_SIZE_4K - 1);
+    uint64_t used = heap_reserved_end - HEAP_VIRT_BASE;
+    if (!size || size > HEAP_VIRT_SIZE - used)
+        return NULL;
+    uint64_t tables = heap_tables_for(used + size) - heap_tables_for(used);
+    if (!pmm_reserve(size + tables * PAGE_SIZE_4K))
+        return NULL;
+    void* start = (void*)(uintptr_t)heap_reserved_end;
+    heap_reserved_end += size;
+    return start;
+}
+
+uint64_t paging_heap_committed(void) {
+    return heap_committed;
+}
+
+// ==== Device window ====
+// Takes `pages` of the window [base, base + limit) whose next free page is
+// *end, with frames for `frames` data pages plus the page tables that will
+// map them set aside first
+static uint64_t window_take(uint64_t* end, uint64_t base, uint64_t limit, uint64_t pages, uint64_t frames) {
+    uint64_t used = *end - base;
+    uint64_t size = pages * PAGE_SIZE_4K;
+    if (size > limit - used)
+        return 0;
+    uint64_t tables = heap_tables_for(used + size) - heap_tables_for(used);
+    if (!pmm_reserve((frames + tables) * PAGE_SIZE_4K))
+        return 0;
+    uint64_t virt = *end;
+    *end += size;
+    return virt;
+}
+
+static uint64_t device_window_take(uint64_t pages, uint64_t frames) {
+    return window_take(&device_window_end, DEVICE_VIRT_BASE, DEVICE_VIRT_SIZE, pages, frames);
+}
+
+// Maps device registers uncached; returns the virtual address of `phys`
+void* paging_map_mmio(uint64_t phys, uint64_t size) {
+    uint64_t base = phys & ~(PAGE_SIZE_4K - 1);
+    uint64_t pages = (phys - base + size + PAGE_SIZE_4K - 1) / PAGE_SIZE_4K;
+    uint64_t irq = spin_lock_irqsave(&paging_lock);
+    uint64_t virt = device_window_take(pages, 0);
+    for (uint64_t i = 0; virt && i < pages; i++)
+        if (map_locked(virt + i * PAGE_SIZE_4K, base + i * PAGE_SIZE_4K, PAGE_SIZE_4K,
+                       PAGE_RW | PAGE_PCD | PAGE_PWT))
+            virt = 0;
+    spin_unlock_irqrestore(&paging_lock, irq);
+    return virt ? (void*)(uintptr_t)(virt + (phys - base)) : NULL;
+}
+
+// Zeroed, physically contiguous memory for device descriptors and rings;
+// *phys is what the device sees. The data frames are taken before mapping
+// them, since the page tables it needs come from the same allocator.
+void* paging_alloc_dma(uint64_t size, uint64_t* phys) {
+    uint64_t pages = (size + PAGE_SIZE_4K - 1) / PAGE_SIZE_4K;
+    uint64_t first = 0;
+    uint64_t irq = spin_lock_irqsave(&paging_lock);
+    uint64_t virt = pages ? device_window_take(pages, pages) : 0;
+    if (virt && !(first = pmm_alloc_contiguous(pages)))
+        virt = 0;
+    for (uint64_t i = 0; virt && i < pages; i++)
+        if (map_locked(virt + i * PAGE_SIZE_4K, first + i * PAGE_SIZE_4K, PAGE_SIZE_4K, PAGE_RW))
+            virt = 0;
+    spin_unlock_irqrestore(&paging_lock, irq);
+    if (!virt)
+        return NULL;
+    uint64_t* p = (uint64_t*)virt;
+    for (size_t i = 0; i < pages * PAGE_SIZE_4K / sizeof(uint64_t); i++)
+        p[i] = 0;
+    *phys = first;
+    return p;
+}
+
+// ==== Mapping window ====
+// Only address space and the tables to map it are set aside: the owner maps
+// frames of its own from its fault handler
+void* paging_map_window_take(uint64_t size) {
+    uint64_t pages = (size + PAGE_SIZE_4K - 1) / PAGE_SIZE_4K;
+    uint64_t irq = spin_lock_irqsave(&paging_lock);
+    uint64_t virt = pages ? window_take(&map_window_end, MAP_VIRT_BASE, MAP_VIRT_SIZE, pages, 0) : 0;
+    spin_unlock_irqrestore(&paging_lock, irq);
+    return (void*)(uintptr_t)virt;
+}
+
+void paging_set_map_fault_handler(PagingFaultHandler handler) {
+    map_fault_handler = handler;
+}
+
+// ==== Page faults ====
+void page_fault_handler_c(uint64_t addr, uint64_t error, uint64_t rip) {
+    // No paging_lock here: the handler may read the page from disk
+    if (!(error & PF_PRESENT) && addr >= MAP_VIRT_BASE && addr < map_window_end
+            && map_fault_handler && !map_fault_handler(addr & ~(PAGE_SIZE_4K - 1), error))
         return;
-    uint64_t phys_start = (uint64_t)heap_base;
-    uint64_t phys_end   = phys_start + heap_size;
-    phys_start &= ~(PAGE_SIZE_2M - 1);
-    phys_end   = (phys_end + PAGE_SIZE_2M - 1) & ~(PAGE_SIZE_2M - 1);
-    uint64_t virt_start = HEAP_VIRT_BASE;
-    uint64_t virt_end   = virt_start + (phys_end - phys_start);
-    for (uint64_t p=phys_start,v=virt_start; p<phys_end; p+=PAGE_SIZE_2M, v+=PAGE_SIZE_2M) {
-        size_t index = (v - HEAP_VIRT_BASE) / PAGE_SIZE_2M;
-        pd_table_heap[index] = (p & ~(PAGE_SIZE_2M - 1)) | PAGE_PRESENT | PAGE_RW | PAGE_PS;
+
+    if (!(error & PF_PRESENT) && addr >= HEAP_VIRT_BASE && addr < heap_reserved_end) {
+        uint64_t page = addr & ~(PAGE_SIZE_4K - 1);
+        int ok = 0;
+        spin_lock(&paging_lock);  // interrupts are already off in the handler
+        if (paging_virt_to_phys(page)) {
+            ok = 1;  // another CPU committed it first
+        } else {
+            uint64_t frame = pmm_alloc_frame();
+            if (frame && !map_locked(page, frame, PAGE_SIZE_4K, PAGE_RW)) {
+                uint64_t* p = (uint64_t*)page;
+                for (size_t i = 0; i < PAGE_SIZE_4K / sizeof(uint64_t); i++)
+                    p[i] = 0;
+                heap_committed += PAGE_SIZE_4K;
+                ok = 1;
+            }
+        }
+        spin_unlock(&paging_lock);
+        if (ok)
+            return;
     }
-    heap_base = (uint8_t*)HEAP_VIRT_BASE;   // use virtual address going forward
-    heap_size = virt_end - virt_start;
+
+    // Not ours to fix: report and stop
+    Window win;
+    init_fullscreen(&win);
+    fb_write_ansi(&win, "\x1b[31mPAGE FAULT\x1b[0m at ");
+    fb_write_hex(&win, addr);
+    fb_write(&win, " error ");
+    fb_write_hex(&win, error);
+    fb_write(&win, " rip ");
+    fb_write_hex(&win, rip);
+    for (;;)
+        __asm__ volatile("cli; hlt");
+}
+
+// CR0.WP: without it the kernel writes through read-only pages unnoticed
+void paging_write_protect(void) {
+    uint64_t cr0;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    __asm__ volatile("mov %0, %%cr0" : : "r"(cr0 | (1ULL << 16)) : "memory");
 }
 
+void paging_init(void) {
+    pml4_table[PAGING_RECURSIVE_SLOT] = (uint64_t)pml4_table | PAGE_PRESENT | PAGE_RW;
+    kernel_pml4 = (uint64_t)pml4_table;
+    heap_reserved_end = HEAP_VIRT_BASE;
+    paging_write_protect();
+
+    // Installed before the heap exists: the first malloc already faults
+    idt_set_gate(14, (uint64_t)page_fault_isr);
+    idt_load();
+}
@@ -26,11 +26,53 @@
 
 #define ENTRIES_PER_TABLE 512
 
+/* Page-fault error code bits */
+#define PF_PRESENT    0x001ULL
+#define PF_WRITE      0x002ULL
+
+/*
+ * Virtual layout
+ *  --------------
+ *  PML4[0]   identity map of low memory (boot.s) and the framebuffer
+ *  PML4[1]   heap: reserved virtual space, backed by 4 KiB frames on first touch
+ *  PML4[2]   device window: MMIO registers (uncached) and DMA pages
+ *  PML4[3]   mapping window: pages mapped on demand by their owner (files)
+ *  PML4[510] recursive slot, exposes every page table at a fixed address
+ */
+#define HEAP_VIRT_BASE        0x0000008000000000ULL
+#define HEAP_VIRT_SIZE        0x0000008000000000ULL  // one PML4 entry (512 GiB)
+#define DEVICE_VIRT_BASE      0x0000010000000000ULL
+#define DEVICE_VIRT_SIZE      0x0000008000000000ULL
+#define MAP_VIRT_BASE         0x0000018000000000ULL
+#define MAP_VIRT_SIZE         0x0000008000000000ULL
+#define PAGING_RECURSIVE_SLOT 510ULL
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-void paging_map_heap(void);
+void paging_init(void);
+void paging_write_protect(void);  // per CPU: read-only pages bind the kernel too
+int paging_map(uint64_t virt, uint64_t phys, uint64_t page_size, uint64_t flags);
+int paging_unmap(uint64_t virt);  // one 4 KiB page; -1 if it was not mapped
+uint64_t paging_virt_to_phys(uint64_t virt);
+
+/* Demand-committed heap window */
+void* paging_heap_extend(uint64_t size);
+uint64_t paging_heap_committed(void);
+
+/* Device window: mapped eagerly, never freed */
+void* paging_map_mmio(uint64_t phys, uint64_t size);
+void* paging_alloc_dma(uint64_t size, uint64_t* phys);
+
+/* Mapping window: handed out once, never reused. A not-present fault there
+ * goes to the handler, which maps the page and returns 0, or returns -1 to
+ * report the fault. It runs with interrupts off but may do polled I/O. */
+typedef int (*PagingFaultHandler)(uint64_t page, uint64_t error);
+void* paging_map_window_take(uint64_t size);
+void paging_set_map_fault_handler(PagingFaultHandler handler);
+
+void page_fault_handler_c(uint64_t addr, uint64_t error, uint64_t rip);
 
 #ifdef __cplusplus
 }
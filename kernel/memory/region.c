@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include "../multiboot2.h"
 #include "../screen/screen.h"
+#include "../smp/spinlock.h"
 
 #define MULTIBOOT_MEMORY_AVAILABLE 1
 
@@ -10,6 +11,20 @@
 MemoryRegion memory_regions[MAX_MEMORY_REGIONS];
 size_t memory_region_count = 0;
 
+/* usable physical ranges, handed out one frame at a time from `next` */
+typedef struct {
+    uint64_t next;
+    uint64_t end;
+} PhysRange;
+
+static PhysRange phys_ranges[MAX_MEMORY_REGIONS];
+static size_t phys_range_count = 0;
+static uint64_t free_frames = 0;      // frames left in phys_ranges
+static uint64_t reserved_frames = 0;  // of those, promised to pmm_reserve callers
+static Spinlock pmm_lock = SPINLOCK_INIT;
+
+#define LOW_MEMORY_END 0x100000ULL  // keep BIOS area and the AP trampoline untouched
+
 /* heap info */
 uint8_t* heap_base = NULL;
 uint64_t heap_size = 0;
@@ -56,31 +71,89 @@ int memory_init(void *mb_info_ptr) {
     if (!memory_region_count)
         return MEM_ERR_NO_REGIONS;
     /* ----------------------------------------------------------
-     * Automatically set heap region after kernel in usable range
+     * Collect every usable range above low memory and the kernel
      * ---------------------------------------------------------- */
-    heap_used = 0;
-    heap_base = 0;
-    uint64_t kernel_end = (uint64_t)&_bss_end;
+    uint64_t kernel_end = ((uint64_t)&_bss_end + 0xFFF) & ~0xFFFULL;
+    phys_range_count = 0;
+    free_frames = 0;
+    reserved_frames = 0;
     for (size_t i = 0; i < memory_region_count; ++i) {
-        uint64_t region_start = memory_regions[i].addr;
-        uint64_t region_end   = memory_regions[i].addr + memory_regions[i].len;
-        if (kernel_end >= region_start && kernel_end <= region_end) { 
-            // let kernel end exactly at region start or end
-            // align heap start up to next 4 KB boundary
-            // while ensuring that the aligned start doesn't push us past this region
-            uint64_t aligned_heap_start = (kernel_end + 0xFFF) & ~0xFFFULL;
-            if (aligned_heap_start < region_end) {
-                heap_base = (uint8_t *)aligned_heap_start;
-                heap_size = region_end - aligned_heap_start;
-            }
-            break;
-        }
+        uint64_t start = memory_regions[i].addr;
+        uint64_t end   = memory_regions[i].addr + memory_regions[i].len;
+        if (start < LOW_MEMORY_END) start = LOW_MEMORY_END;
+        if (start < kernel_end) start = kernel_end;
+        start = (start + 0xFFF) & ~0xFFFULL;
+        end &= ~0xFFFULL;
+        if (start >= end)
+            continue;
+        phys_ranges[phys_range_count].next = start;
+        phys_ranges[phys_range_count].end  = end;
+        phys_range_count++;
+        free_frames += (end - start) >> 12;
     }
-    if (!heap_base)
+
+    if (!phys_range_count)
         return MEM_ERR_NO_REGIONS;
+    heap_used = 0;
+    heap_base = 0;
+    heap_size = 0;
     return MEM_OK;
 }
 
+// Sets frames aside for a later pmm_alloc_frame, so that callers which cannot
+// fail (the page-fault handler) never find the pool empty.
+int pmm_reserve(uint64_t bytes) {
+    uint64_t frames = (bytes + 0xFFF) >> 12;
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    int ok = frames <= free_frames - reserved_frames;
+    if (ok)
+        reserved_frames += frames;
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return ok;
+}
+
+// Hands out one 4 KiB frame, drawn against an earlier reservation
+uint64_t pmm_alloc_frame(void) {
+    uint64_t frame = 0;
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    for (size_t i = 0; i < phys_range_count; ++i) {
+        if (phys_ranges[i].next >= phys_ranges[i].end)
+            continue;
+        frame = phys_ranges[i].next;
+        phys_ranges[i].next += 0x1000;
+        free_frames--;
+        if (reserved_frames)
+            reserved_frames--;
+        break;
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return frame;
+}
+
+// Hands out `count` physically contiguous frames in one go, so that no other
+// allocation (such as a page table) lands between them; 0 if no range has
+// that many left. Drawn against an earlier reservation like pmm_alloc_frame.
+uint64_t pmm_alloc_contiguous(uint64_t count) {
+    uint64_t first = 0;
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    for (size_t i = 0; i < phys_range_count; ++i) {
+        if (phys_ranges[i].end - phys_ranges[i].next < (count << 12))
+            continue;
+        first = phys_ranges[i].next;
+        phys_ranges[i].next += count << 12;
+        free_frames -= count;
+        reserved_frames = reserved_frames > count ? reserved_frames - count : 0;
+        break;
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return first;
+}
+
+// Bytes that can still be reserved
+uint64_t pmm_available(void) {
+    return (free_frames - reserved_frames) << 12;
+}
+
 uint64_t memory_total_with_regions(void) {
     uint64_t total = 0;
     for (size_t i = 0; i < memory_region_count; ++i)
@@ -10,3 +10,9 @@ typedef struct {
 
 int memory_init(void *mb_info_ptr);
 uint64_t memory_total_with_regions(void);
+
+/* Physical frame allocator over every usable region (above the kernel image) */
+int pmm_reserve(uint64_t bytes);
+uint64_t pmm_alloc_frame(void);
+uint64_t pmm_alloc_contiguous(uint64_t count);
+uint64_t pmm_available(void);
@@ -0,0 +1,170 @@
+#include "slab.h"
+
+#define SLAB_MAGIC 0x51AB
+
+// ==== Size classes ====
+static const uint32_t slab_class_size[SLAB_CLASS_COUNT] = {
+    8, 16, 32, 64, 128, 256, 512, 1024, SLAB_MAX_SIZE
+};
+
+typedef struct {
+    SlabPage* partial;      // pages with at least one free object
+    SlabPage* empty;        // one fully free page kept around to avoid thrashing
+} SlabClass;
+
+static SlabClass slab_classes[SLAB_CLASS_COUNT];
+static uint64_t  slab_live[SLAB_CLASS_COUNT];  // objects handed out per class
+static uint64_t  slab_page_count = 0;
+static uint64_t  slab_used_bytes = 0;
+
+int slab_class_index(size_t size) {
+    int c = 0;
+    while (c < SLAB_CLASS_COUNT - 1 && slab_class_size[c] < size)
+        c++;
+    return c;
+}
+
+static inline SlabPage* page_of(const void* ptr) {
+    uintptr_t page = (uintptr_t)ptr & ~(SLAB_PAGE_SIZE - 1);
+    return (SlabPage*)(page + sizeof(uint64_t));
+}
+
+// ==== Partial list helpers ====
+static inline void partial_push(SlabClass* sc, SlabPage* sp) {
+    sp->prev = NULL;
+    sp->next = sc->partial;
+    if (sc->partial)
+        sc->partial->prev = sp;
+    sc->partial = sp;
+}
+
+static inline void partial_remove(SlabClass* sc, SlabPage* sp) {
+    if (sp->prev) sp->prev->next = sp->next;
+    else sc->partial = sp->next;
+    if (sp->next) sp->next->prev = sp->prev;
+    sp->next = sp->prev = NULL;
+}
+
+// ==== Page carving ====
+static SlabPage* slab_new_page(int class_index) {
+    // buddy_malloc returns the address right after its 8-byte header
+    void* raw = buddy_malloc(SLAB_PAGE_SIZE - sizeof(uint64_t));
+    if (!raw)
+        return NULL;
+    SlabPage* sp = (SlabPage*)raw;
+    uint8_t* page = (uint8_t*)raw - sizeof(uint64_t);
+    uint32_t size = slab_class_size[class_index];
+
+    sp->next = sp->prev = NULL;
+    sp->class_index = (uint16_t)class_index;
+    sp->in_use = 0;
+    sp->capacity = (uint16_t)((SLAB_PAGE_SIZE - SLAB_DATA_OFFSET) / size);
+    sp->magic = SLAB_MAGIC;
+
+    // Thread objects into the free list in address order
+    void* head = NULL;
+    for (int i = sp->capacity - 1; i >= 0; i--) {
+        void** obj = (void**)(page + SLAB_DATA_OFFSET + (size_t)i * size);
+        *obj = head;
+        head = obj;
+    }
+    sp->free = head;
+    slab_page_count++;
+    return sp;
+}
+
+// ==== Allocation ====
+void* slab_alloc(size_t size) {
+    if (size == 0 || size > SLAB_MAX_SIZE)
+        return NULL;
+    return slab_alloc_class(slab_class_index(size));
+}
+
+void* slab_alloc_class(int c) {
+    SlabClass* sc = &slab_classes[c];
+
+    SlabPage* sp = sc->partial;
+    if (!sp) {
+        if (sc->empty) {
+            sp = sc->empty;
+            sc->empty = NULL;
+        } else {
+            sp = slab_new_page(c);
+            if (!sp)
+                return NULL;
+        }
+        partial_push(sc, sp);
+    }
+
+    void** obj = (void**)sp->free;
+    sp->free = *obj;
+    sp->in_use++;
+    if (!sp->free)
+        partial_remove(sc, sp);  // page is now full
+    slab_used_bytes += slab_class_size[c];
+    slab_live[c]++;
+    return obj;
+}
+
+// ==== Free ====
+void slab_free(void* ptr) {
+    if (!ptr)
+        return;
+    SlabPage* sp = page_of(ptr);
+    if (sp->magic != SLAB_MAGIC)
+        return;  // not ours (or corrupted): leak rather than scribble
+    SlabClass* sc = &slab_classes[sp->class_index];
+
+    int was_full = (sp->free == NULL);
+    *(void**)ptr = sp->free;
+    sp->free = ptr;
+    sp->in_use--;
+    slab_used_bytes -= slab_class_size[sp->class_index];
+    slab_live[sp->class_index]--;
+
+    if (was_full)
+        partial_push(sc, sp);
+    if (sp->in_use)
+        return;
+
+    // Page is completely free: keep one spare per class, return the rest
+    partial_remove(sc, sp);
+    if (!sc->empty) {
+        sc->empty = sp;
+        return;
+    }
+    sp->magic = 0;
+    slab_page_count--;
+    buddy_free(sp);
+}
+
+size_t slab_object_size(const void* ptr) {
+    const SlabPage* sp = page_of(ptr);
+    if (sp->magic != SLAB_MAGIC)
+        return 0;
+    return slab_class_size[sp->class_index];
+}
+
+int slab_class_of(const void* ptr) {
+    const SlabPage* sp = page_of(ptr);
+    if (sp->magic != SLAB_MAGIC)
+        return -1;
+    return sp->class_index;
+}
+
+// ==== Info ====
+uint64_t slab_pages(void) {
+    return slab_page_count;
+}
+
+uint64_t slab_bytes_in_use(void) {
+    return slab_used_bytes;
+}
+
+uint64_t slab_class_live(int class_index) {
+    return slab_live[class_index];
+}
+
+uint32_t slab_class_bytes(int class_index) {
+    return slab_class_size[class_index];
+}
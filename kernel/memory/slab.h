@@ -0,0 +1,58 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "dynamic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Size-class slab layer
+ *  ---------------------
+ *  Small objects are carved out of single buddy pages (MIN_ORDER). Each page
+ *  keeps a SlabPage header right after the 8-byte buddy header, and objects
+ *  start at SLAB_DATA_OFFSET. Because buddy blocks are always page-aligned,
+ *  a buddy pointer always sits exactly sizeof(uint64_t) bytes into a page,
+ *  while slab objects never do. That is how free() tells the two apart.
+ */
+#define SLAB_PAGE_SIZE   (1UL << MIN_ORDER)
+#define SLAB_DATA_OFFSET 64
+#define SLAB_MIN_SIZE    8
+#define SLAB_MAX_SIZE    (((SLAB_PAGE_SIZE - SLAB_DATA_OFFSET) / 2) & ~7UL)  // two objects per page
+#define SLAB_CLASS_COUNT MEMORY_SLAB_CLASSES  // 8, 16, 32, 64, 128, 256, 512, 1024, SLAB_MAX_SIZE
+
+typedef struct SlabPage {
+    struct SlabPage* next;      // partial list links
+    struct SlabPage* prev;
+    void*    free;              // singly linked free objects
+    uint16_t class_index;
+    uint16_t in_use;
+    uint16_t capacity;
+    uint16_t magic;
+} SlabPage;
+
+/*
+ * Not thread-safe on their own: callers hold the heap lock (see dynamic.c),
+ * which fronts this layer with per-CPU magazines.
+ */
+void*  slab_alloc(size_t size);
+void*  slab_alloc_class(int class_index);
+void   slab_free(void* ptr);
+size_t slab_object_size(const void* ptr);
+int    slab_class_index(size_t size);
+int    slab_class_of(const void* ptr);  // -1 if ptr is not a slab object
+
+static inline int slab_owns(const void* ptr) {
+    return ((uintptr_t)ptr & (SLAB_PAGE_SIZE - 1)) != sizeof(uint64_t);
+}
+
+/* Info helpers */
+uint64_t slab_pages(void);
+uint64_t slab_bytes_in_use(void);
+uint64_t slab_class_live(int class_index);
+uint32_t slab_class_bytes(int class_index);
+
+#ifdef __cplusplus
+}
+#endif
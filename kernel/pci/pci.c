@@ -0,0 +1,133 @@
+#include <stddef.h>
+#include "../io.h"
+#include "pci.h"
+
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+
+static PciDevice pci_devices[PCI_MAX_DEVICES];
+static int pci_count = 0;
+
+// ==== Configuration mechanism #1 ====
+static uint32_t config_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return 0x80000000U | ((uint32_t)bus << 16) | ((uint32_t)slot << 11)
+         | ((uint32_t)func << 8) | (offset & 0xFC);
+}
+
+static uint32_t config_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    outl(PCI_CONFIG_ADDRESS, config_address(bus, slot, func, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+uint32_t pci_read32(const PciDevice *dev, uint8_t offset) {
+    return config_read(dev->bus, dev->slot, dev->func, offset);
+}
+
+uint16_t pci_read16(const PciDevice *dev, uint8_t offset) {
+    return (uint16_t)(pci_read32(dev, offset) >> ((offset & 2) * 8));
+}
+
+uint8_t pci_read8(const PciDevice *dev, uint8_t offset) {
+    return (uint8_t)(pci_read32(dev, offset) >> ((offset & 3) * 8));
+}
+
+void pci_write32(const PciDevice *dev, uint8_t offset, uint32_t value) {
+    outl(PCI_CONFIG_ADDRESS, config_address(dev->bus, dev->slot, dev->func, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+// A 16-bit access to just this word: rewriting the whole dword would write the
+// neighbouring word back too, and clear its write-1-to-clear bits (Status)
+void pci_write16(const PciDevice *dev, uint8_t offset, uint16_t value) {
+    outl(PCI_CONFIG_ADDRESS, config_address(dev->bus, dev->slot, dev->func, offset));
+    outw(PCI_CONFIG_DATA + (offset & 2), value);
+}
+
+// ==== Enumeration ====
+static void pci_add(uint8_t bus, uint8_t slot, uint8_t func) {
+    if (pci_count >= PCI_MAX_DEVICES)
+        return;
+    PciDevice *dev = &pci_devices[pci_count++];
+    dev->bus = bus;
+    dev->slot = slot;
+    dev->func = func;
+    uint32_t id = config_read(bus, slot, func, PCI_VENDOR_ID);
+    dev->vendor_id = (uint16_t)id;
+    dev->device_id = (uint16_t)(id >> 16);
+    uint32_t class_reg = config_read(bus, slot, func, 0x08);
+    dev->class_code = (uint8_t)(class_reg >> 24);
+    dev->subclass = (uint8_t)(class_reg >> 16);
+    dev->prog_if = (uint8_t)(class_reg >> 8);
+    dev->irq_line = pci_read8(dev, PCI_INTERRUPT_LINE);
+}
+
+int pci_init(void) {
+    pci_count = 0;
+    for (int bus = 0; bus < 256; bus++) {
+        for (int slot = 0; slot < 32; slot++) {
+            if ((uint16_t)config_read(bus, slot, 0, PCI_VENDOR_ID) == 0xFFFF)
+                continue;
+            uint8_t header = (uint8_t)(config_read(bus, slot, 0, 0x0C) >> 16);
+            int funcs = (header & 0x80) ? 8 : 1;  // multi-function device
+            for (int func = 0; func < funcs; func++)
+                if ((uint16_t)config_read(bus, slot, func, PCI_VENDOR_ID) != 0xFFFF)
+                    pci_add(bus, slot, func);
+        }
+    }
+    return pci_count;
+}
+
+int pci_device_count(void) {
+    return pci_count;
+}
+
+const PciDevice* pci_get_device(int index) {
+    if (index < 0 || index >= pci_count)
+        return NULL;
+    return &pci_devices[index];
+}
+
+const PciDevice* pci_find_class(uint8_t class_code, uint8_t subclass, int nth) {
+    for (int i = 0; i < pci_count; i++)
+        if (pci_devices[i].class_code == class_code && pci_devices[i].subclass == subclass && nth-- == 0)
+            return &pci_devices[i];
+    return NULL;
+}
+
+const PciDevice* pci_find_device(uint16_t vendor_id, uint16_t device_id, int nth) {
+    for (int i = 0; i < pci_count; i++)
+        if (pci_devices[i].vendor_id == vendor_id && pci_devices[i].device_id == device_id && nth-- == 0)
+            return &pci_devices[i];
+    return NULL;
+}
+
+uint64_t pci_bar(const PciDevice *dev, int n, int *is_io) {
+    if (n < 0 || n > 5)
+        return 0;
+    uint32_t bar = pci_read32(dev, PCI_BAR0 + n * 4);
+    if (bar & 1) {
+        if (is_io) *is_io = 1;
+        return bar & ~0x3U;
+    }
+    if (is_io) *is_io = 0;
+    uint64_t base = bar & ~0xFU;
+    if (((bar >> 1) & 3) == 2 && n < 5)  // 64-bit BAR
+        base |= (uint64_t)pci_read32(dev, PCI_BAR0 + (n + 1) * 4) << 32;
+    return base;
+}
+
+void pci_enable(const PciDevice *dev, uint16_t command_bits) {
+    pci_write16(dev, PCI_COMMAND, pci_read16(dev, PCI_COMMAND) | command_bits);
+}
+
+uint8_t pci_find_capability(const PciDevice *dev, uint8_t cap_id) {
+    if (!(pci_read16(dev, PCI_STATUS) & PCI_STATUS_CAPABILITIES))
+        return 0;
+    uint8_t offset = pci_read8(dev, PCI_CAPABILITIES) & 0xFC;
+    for (int guard = 0; offset && guard < 48; guard++) {
+        if (pci_read8(dev, offset) == cap_id)
+            return offset;
+        offset = pci_read8(dev, offset + 1) & 0xFC;
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+
+#define PCI_MAX_DEVICES 64
+
+// Configuration space offsets
+#define PCI_VENDOR_ID      0x00
+#define PCI_DEVICE_ID      0x02
+#define PCI_COMMAND        0x04
+#define PCI_STATUS         0x06
+#define PCI_PROG_IF        0x09
+#define PCI_SUBCLASS       0x0A
+#define PCI_CLASS          0x0B
+#define PCI_HEADER_TYPE    0x0E
+#define PCI_BAR0           0x10
+#define PCI_CAPABILITIES   0x34
+#define PCI_INTERRUPT_LINE 0x3C
+
+// Command register bits
+#define PCI_COMMAND_IO          0x0001
+#define PCI_COMMAND_MEMORY      0x0002
+#define PCI_COMMAND_BUS_MASTER  0x0004
+#define PCI_COMMAND_INTX_OFF    0x0400
+
+// Status register bits
+#define PCI_STATUS_CAPABILITIES 0x0010
+
+// Class codes used by the drivers
+#define PCI_CLASS_STORAGE  0x01
+#define PCI_SUBCLASS_IDE   0x01
+#define PCI_SUBCLASS_SATA  0x06
+
+typedef struct {
+    uint8_t  bus;
+    uint8_t  slot;
+    uint8_t  func;
+    uint8_t  class_code;
+    uint8_t  subclass;
+    uint8_t  prog_if;
+    uint8_t  irq_line;        // legacy PIC line, 0xFF if none
+    uint16_t vendor_id;
+    uint16_t device_id;
+} PciDevice;
+
+// Scans every bus/slot/function once through configuration mechanism #1.
+// Returns the number of functions found.
+int pci_init(void);
+
+int pci_device_count(void);
+const PciDevice* pci_get_device(int index);
+
+// nth function with the given class/subclass (or vendor/device), or NULL
+const PciDevice* pci_find_class(uint8_t class_code, uint8_t subclass, int nth);
+const PciDevice* pci_find_device(uint16_t vendor_id, uint16_t device_id, int nth);
+
+uint32_t pci_read32(const PciDevice *dev, uint8_t offset);
+uint16_t pci_read16(const PciDevice *dev, uint8_t offset);
+uint8_t  pci_read8(const PciDevice *dev, uint8_t offset);
+void     pci_write32(const PciDevice *dev, uint8_t offset, uint32_t value);
+void     pci_write16(const PciDevice *dev, uint8_t offset, uint16_t value);
+
+// Base address of BAR n (a 64-bit memory BAR spans n and n+1);
+// *is_io tells port space from memory space. 0 if the BAR is unused.
+uint64_t pci_bar(const PciDevice *dev, int n, int *is_io);
+
+// Sets PCI_COMMAND_* bits (I/O, memory decoding, bus mastering)
+void pci_enable(const PciDevice *dev, uint16_t command_bits);
+
+// Offset of the first capability with the given id, or 0
+uint8_t pci_find_capability(const PciDevice *dev, uint8_t cap_id);
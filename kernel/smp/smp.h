@@ -2,6 +2,22 @@
 #pragma once
 #include <stdint.h>
 
+#define MAX_CPUS 16
+
 void smp_init(void);
 void ap_main(void);
 uint32_t get_cpu_id(void);
+
+// Per-CPU data: GS base points at the running CPU's slot, whose first field
+// is the CPU index. percpu_init must run on each CPU before this_cpu().
+void percpu_init(uint32_t cpu);
+static inline uint32_t this_cpu(void) {
+    uint32_t cpu;
+    __asm__ volatile("movl %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+// Runs fn(arg) on every online CPU (the caller included) and waits for all
+// of them; returns how many CPUs ran it
+uint32_t smp_cpu_count(void);
+uint32_t smp_run_on_all(void (*fn)(void *), void *arg);
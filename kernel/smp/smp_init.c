@@ -28,7 +28,6 @@ extern uint64_t pdpt_table[512];
 
 // === Constants ===
 #define TRAMPOLINE_ADDR 0x7000
-#define MAX_CPUS 16
 #define LAPIC_BASE 0xFEE00000ULL
 
 // Page flags (local)
@@ -44,6 +43,28 @@ extern uint64_t pdpt_table[512];
 // === Internal state ===
 static uint8_t cpu_apic_ids[MAX_CPUS];
 static int cpu_count = 1; // BSP = 1
+volatile int cpu_ready[MAX_CPUS] = {0};
+
+// Per-CPU slots, reached through GS base (see this_cpu)
+typedef struct {
+    uint32_t index;
+} CpuLocal;
+
+static CpuLocal cpu_locals[MAX_CPUS];
+
+#define MSR_GS_BASE 0xC0000101
+
+void percpu_init(uint32_t cpu) {
+    cpu_locals[cpu].index = cpu;
+    uint64_t base = (uint64_t)&cpu_locals[cpu];
+    asm volatile ("wrmsr" : : "c"(MSR_GS_BASE), "a"((uint32_t)base), "d"((uint32_t)(base >> 32)));
+}
+
+// Work broadcast to APs, which poll for it from ap_main
+static void (*volatile smp_work_fn)(void *) = NULL;
+static void *volatile smp_work_arg = NULL;
+static volatile uint32_t smp_work_generation = 0;
+static volatile uint32_t smp_work_done = 0;
 
 // --- Fake detection until MADT parser is added ---
 static void detect_cpus_fake(void) {
@@ -125,6 +146,38 @@ void smp_init(void) {
     }
 }
 
+uint32_t smp_cpu_count(void) {
+    uint32_t count = 1;
+    for (int i = 0; i < MAX_CPUS; i++)
+        if (cpu_ready[i])
+            count++;
+    return count;
+}
+
+uint32_t smp_run_on_all(void (*fn)(void *), void *arg) {
+    uint32_t others = smp_cpu_count() - 1;
+    smp_work_fn = fn;
+    smp_work_arg = arg;
+    smp_work_done = 0;
+    __atomic_add_fetch(&smp_work_generation, 1, __ATOMIC_RELEASE);
+    fn(arg);
+    while (__atomic_load_n(&smp_work_done, __ATOMIC_ACQUIRE) < others)
+        __asm__ volatile("pause");
+    smp_work_fn = NULL;
+    return others + 1;
+}
+
+static void smp_poll_work(uint32_t *seen) {
+    uint32_t generation = __atomic_load_n(&smp_work_generation, __ATOMIC_ACQUIRE);
+    if (generation == *seen)
+        return;
+    *seen = generation;
+    void (*fn)(void *) = smp_work_fn;
+    if (fn)
+        fn(smp_work_arg);
+    __atomic_add_fetch(&smp_work_done, 1, __ATOMIC_RELEASE);
+}
+
 uint32_t get_cpu_id(void) {
     uint32_t eax, ebx, ecx, edx;
     asm volatile("cpuid"
@@ -137,25 +190,40 @@ uint32_t get_cpu_id(void) {
 
 
 #include "../user/application.h"
-volatile int cpu_ready[MAX_CPUS] = {0};
-extern uint32_t MAX_APPLICATIONS;
 extern Application *apps;
 
+// MONITOR/MWAIT (CPUID.1:ECX bit 3) lets an idle AP sleep until the work
+// generation is written instead of spinning on it
+static int cpu_has_mwait(void) {
+    uint32_t ecx;
+    asm volatile("cpuid" : "=c"(ecx) : "a"(1) : "ebx", "edx");
+    return (ecx >> 3) & 1;
+}
+
 void ap_main(void) {
     uint32_t id = get_cpu_id();
+    if (id >= MAX_CPUS)
+        for (;;) __asm__ volatile("cli; hlt");
+    percpu_init(id);
+    paging_write_protect();
     interrupts_init();
 
+    uint32_t seen = smp_work_generation;
     cpu_ready[id] = 1;
 
     fb_write_ansi(apps[0].window, "\033[36m[AP] CPU ready.\033[0m\n");
 
+    // Apps only run on the BSP, which owns them; APs only take broadcast work.
+    // No timer or IPI reaches APs yet, so they wait on the generation itself.
+    int mwait = cpu_has_mwait();
     while (1) {
-        for (uint32_t i = 1; i < MAX_APPLICATIONS; i++) {
-            if (apps[i].run != NULL) 
-                app_run(&apps[i], i);
+        smp_poll_work(&seen);
+        if (mwait) {
+            __asm__ volatile("monitor" : : "a"(&smp_work_generation), "c"(0), "d"(0));
+            if (__atomic_load_n(&smp_work_generation, __ATOMIC_ACQUIRE) == seen)
+                __asm__ volatile("mwait" : : "a"(0), "c"(0));
+        } else {
+            __asm__ volatile("pause");
         }
-
-        // Halt until next timer interrupt or IPI
-        __asm__ volatile("hlt");
     }
 }
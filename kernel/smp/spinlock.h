@@ -0,0 +1,42 @@
+// spinlock.h
+#pragma once
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t locked;
+} Spinlock;
+
+#define SPINLOCK_INIT {0}
+
+static inline void spin_lock(Spinlock *lock) {
+    while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE))
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED))
+            __asm__ volatile("pause");
+}
+
+static inline void spin_unlock(Spinlock *lock) {
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+// Local interrupt masking, so a lock holder cannot be re-entered from an ISR
+static inline uint64_t irq_save(void) {
+    uint64_t flags;
+    __asm__ volatile("pushfq; popq %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint64_t flags) {
+    if (flags & 0x200)  // IF
+        __asm__ volatile("sti" : : : "memory");
+}
+
+static inline uint64_t spin_lock_irqsave(Spinlock *lock) {
+    uint64_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(Spinlock *lock, uint64_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
@@ -9,6 +9,10 @@ void app_init(Application* app, void (*func)(Application*, uint32_t appid), Wind
     app->terminate = NULL;
     app->save = NULL;
     app->output_state = 0;
+    app->scratch.base = NULL;
+    app->scratch.size = 0;
+    app->scratch.used = 0;
+    app->killed = 0;
     app->input[0] = '\0';
     app->output[0] = '\0';
 }
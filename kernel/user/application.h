@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include "../screen/screen.h"
 #include "../memory/dynamic.h"
+#include "../memory/arena.h"
 
 /*
 TERMINATION PROTOCOL
@@ -36,6 +37,8 @@ typedef struct Application {
     uint32_t input_state;
     char** vars;
     size_t MAX_VARS;
+    Arena scratch;                     // reset after every console_execute, created on first use
+    uint8_t killed;                    // killed by its own command: console_execute frees scratch
 } Application;
 
 void app_init(Application* app, void (*func)(Application*, uint32_t appid), Window* win);
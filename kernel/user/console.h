@@ -19,6 +19,12 @@ int find_or_insert_var(const char* name);
 void widget_run(Application* app, uint32_t appid);
 void widget_terminate(Application* app, uint32_t appid);
 void fb_image_from_file(Window *win, int file_id, size_t target_width, size_t target_height) ;
+int console_bench(Window *win, const char *what);
+int console_mem(Window *win, const char *args);
+int console_disk(Window *win, const char *args);
+int console_write(Window *win, const char *args, int append);
+int console_rm(Window *win, const char *path);
+int console_sync(Window *win);
 unsigned char get_char(Window* win);
 void lose_focus(Window* win);
 
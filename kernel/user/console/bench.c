@@ -0,0 +1,360 @@
+#include "../console.h"
+#include "../../smp/smp.h"
+#include "../../file/block.h"
+
+// -----------------------------------------------------------------------------
+// Timing helpers (TSC calibrated once against PIT channel 2)
+// -----------------------------------------------------------------------------
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static uint64_t tsc_hz(void) {
+    static uint64_t hz = 0;
+    if (hz)
+        return hz;
+    // One-shot 10 ms countdown (1193182 Hz / 100) gated through port 0x61
+    uint8_t gate = inb(0x61);
+    outb(0x61, (gate & ~0x03));
+    outb(0x43, 0xB0);               // channel 2, lobyte/hibyte, mode 0
+    outb(0x42, 11932 & 0xFF);
+    outb(0x42, 11932 >> 8);
+    uint64_t start = rdtsc();
+    outb(0x61, (gate & ~0x02) | 0x01);
+    while (!(inb(0x61) & 0x20))
+        ;
+    hz = (rdtsc() - start) * 100;
+    outb(0x61, gate);
+    if (!hz)
+        hz = 1;
+    return hz;
+}
+
+static uint64_t per_second(uint64_t ops, uint64_t cycles) {
+    if (!cycles)
+        return 0;
+    return ops * tsc_hz() / cycles;
+}
+
+static void bench_label(Window *win, const char *name) {
+    fb_write_ansi(win, "\033[35m");
+    fb_write(win, name);
+    fb_write_ansi(win, "\033[0m ");
+}
+
+// -----------------------------------------------------------------------------
+// bench mem: allocation throughput per size and live-object capacity
+// -----------------------------------------------------------------------------
+#define BENCH_BATCH       64
+#define BENCH_ROUNDS      256
+#define BENCH_MAX_OBJECTS (1 << 16)
+
+static void bench_malloc_throughput(Window *win, size_t size) {
+    void *ptrs[BENCH_BATCH];
+    uint64_t ops = 0;
+    uint64_t start = rdtsc();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        int n = 0;
+        for (; n < BENCH_BATCH; n++) {
+            ptrs[n] = malloc(size);
+            if (!ptrs[n])
+                break;
+        }
+        for (int i = 0; i < n; i++)
+            free(ptrs[i]);
+        ops += n;
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    bench_label(win, "malloc");
+    fb_write_dec(win, size);
+    fb_write(win, "B: ");
+    fb_write_dec(win, per_second(ops, cycles));
+    fb_write(win, " allocs/s, ");
+    fb_write_dec(win, ops ? cycles / ops : 0);
+    fb_write(win, " cycles/op\n");
+}
+
+// Keeps as many objects of the given size alive as possible (linked through
+// their first word), then frees every other one to expose fragmentation.
+static void bench_live_state(Window *win, size_t size) {
+    memory_flush_caches();
+    uint64_t used_before = memory_used();
+    void *head = NULL;
+    uint64_t count = 0;
+    while (count < BENCH_MAX_OBJECTS) {
+        void **obj = malloc(size);
+        if (!obj)
+            break;
+        *obj = head;
+        head = obj;
+        count++;
+    }
+    uint64_t used_full = memory_used() - used_before;
+
+    // Free every other object
+    void **prev = (void **)&head;
+    uint64_t kept = 0;
+    while (*prev) {
+        void **victim = (void **)*prev;
+        *prev = *victim;
+        free(victim);
+        if (!*prev)
+            break;
+        prev = (void **)*prev;
+        kept++;
+    }
+    uint64_t used_half = memory_used() - used_before;
+
+    while (head) {
+        void *next = *(void **)head;
+        free(head);
+        head = next;
+    }
+    memory_flush_caches();
+    uint64_t leaked = memory_used() - used_before;
+
+    bench_label(win, "live");
+    fb_write_dec(win, count);
+    fb_write(win, " x ");
+    fb_write_dec(win, size);
+    fb_write(win, "B in ");
+    fb_write_dec(win, used_full / 1024);
+    fb_write(win, "KB (");
+    fb_write_dec(win, used_full ? count * size * 100 / used_full : 0);
+    fb_write(win, "% useful), half freed ");
+    fb_write_dec(win, used_half / 1024);
+    fb_write(win, "KB (");
+    fb_write_dec(win, used_half ? kept * size * 100 / used_half : 0);
+    fb_write(win, "% useful)");
+    if (leaked) {
+        fb_write_ansi(win, " \033[31mleaked ");
+        fb_write_dec(win, leaked);
+        fb_write_ansi(win, "B\033[0m");
+    }
+    fb_write(win, "\n");
+}
+
+static void bench_memory(Window *win) {
+    static const size_t sizes[] = { 8, 24, 64, 256, 1024, 2000, 4096, 16384 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        bench_malloc_throughput(win, sizes[i]);
+    bench_live_state(win, 64);
+    bench_live_state(win, 512);
+}
+
+// -----------------------------------------------------------------------------
+// bench heap: malloc/free latency as the number of free fragments grows
+// -----------------------------------------------------------------------------
+#define BENCH_PAGE_PAYLOAD 4000  // lands in a single 4 KB buddy block
+#define BENCH_LATENCY_OPS  1024
+
+static void bench_fragmented_heap(Window *win, uint64_t fragments) {
+    // Allocate 2*fragments pages linked through their first word, then
+    // release every other one so that none of the free pages can coalesce.
+    void *head = NULL;
+    uint64_t count = 0;
+    while (count < 2 * fragments) {
+        void **obj = malloc(BENCH_PAGE_PAYLOAD);
+        if (!obj)
+            break;
+        *obj = head;
+        head = obj;
+        count++;
+    }
+    void **prev = (void **)&head;
+    uint64_t holes = 0;
+    while (*prev) {
+        void **victim = (void **)*prev;
+        *prev = *victim;
+        free(victim);
+        holes++;
+        if (!*prev)
+            break;
+        prev = (void **)*prev;
+    }
+
+    uint64_t start = rdtsc();
+    for (int i = 0; i < BENCH_LATENCY_OPS; i++) {
+        void *p = malloc(BENCH_PAGE_PAYLOAD);
+        free(p);
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    while (head) {
+        void *next = *(void **)head;
+        free(head);
+        head = next;
+    }
+
+    bench_label(win, "heap");
+    fb_write_dec(win, holes);
+    fb_write(win, " free fragments: ");
+    fb_write_dec(win, cycles / (2 * BENCH_LATENCY_OPS));
+    fb_write(win, " cycles per malloc/free\n");
+}
+
+static void bench_heap(Window *win) {
+    for (uint64_t fragments = 10; fragments <= 100000; fragments *= 10)
+        bench_fragmented_heap(win, fragments);
+}
+
+// -----------------------------------------------------------------------------
+// bench smp: aggregate malloc/free throughput with every online CPU at once
+// -----------------------------------------------------------------------------
+#define BENCH_SMP_ROUNDS 2048
+
+typedef struct {
+    uint64_t ops[MAX_CPUS];
+    uint64_t cycles[MAX_CPUS];
+} SmpBenchResult;
+
+static void bench_smp_worker(void *arg) {
+    SmpBenchResult *result = arg;
+    static const size_t sizes[] = { 16, 64, 256, 1024 };
+    void *ptrs[BENCH_BATCH];
+    uint64_t ops = 0;
+    uint64_t start = rdtsc();
+    for (int r = 0; r < BENCH_SMP_ROUNDS; r++) {
+        size_t size = sizes[r & 3];
+        int n = 0;
+        for (; n < BENCH_BATCH; n++) {
+            ptrs[n] = malloc(size);
+            if (!ptrs[n])
+                break;
+        }
+        for (int i = 0; i < n; i++)
+            free(ptrs[i]);
+        ops += n;
+    }
+    uint32_t cpu = this_cpu();
+    result->cycles[cpu] = rdtsc() - start;
+    result->ops[cpu] = ops;
+}
+
+static uint64_t bench_smp_run(SmpBenchResult *result, int all_cpus, uint32_t *cpus) {
+    for (int i = 0; i < MAX_CPUS; i++)
+        result->ops[i] = result->cycles[i] = 0;
+    if (all_cpus) {
+        *cpus = smp_run_on_all(bench_smp_worker, result);
+    } else {
+        *cpus = 1;
+        bench_smp_worker(result);
+    }
+    // CPUs ran side by side: the slowest one bounds the wall time
+    uint64_t ops = 0, cycles = 0;
+    for (int i = 0; i < MAX_CPUS; i++) {
+        ops += result->ops[i];
+        if (result->cycles[i] > cycles)
+            cycles = result->cycles[i];
+    }
+    return per_second(ops, cycles);
+}
+
+static void bench_smp(Window *win) {
+    static SmpBenchResult result;
+    uint32_t cpus;
+    uint64_t single = bench_smp_run(&result, 0, &cpus);
+    uint64_t all = bench_smp_run(&result, 1, &cpus);
+
+    bench_label(win, "smp");
+    fb_write(win, "1 CPU: ");
+    fb_write_dec(win, single);
+    fb_write(win, " allocs/s\n");
+    bench_label(win, "smp");
+    fb_write_dec(win, cpus);
+    fb_write(win, cpus == 1 ? " CPU: " : " CPUs: ");
+    fb_write_dec(win, all);
+    fb_write(win, " allocs/s (");
+    fb_write_dec(win, single ? all * 100 / single : 0);
+    fb_write(win, "% of 1 CPU)\n");
+}
+
+// -----------------------------------------------------------------------------
+// bench disk: sequential read throughput from the start of a block device
+// (the mounted one unless named, fat32.img under QEMU) for growing request
+// sizes. Requests above one command are split by the driver; on NCQ and
+// virtio disks the pieces are in flight together.
+// -----------------------------------------------------------------------------
+#define BENCH_DISK_SECTORS 16384  // 8 MB
+#define BENCH_DISK_MAX_READ 1024  // sectors per request, 512 KB
+
+static void bench_disk_run(Window *win, BlockDevice *dev, uint8_t *buf, uint32_t per_read) {
+    uint64_t total = dev->blocks < BENCH_DISK_SECTORS ? dev->blocks : BENCH_DISK_SECTORS;
+    uint64_t reads = 0;
+    uint64_t start = rdtsc();
+    for (uint64_t lba = 0; lba + per_read <= total; lba += per_read) {
+        if (block_read(dev, lba, per_read, buf) != 0) {
+            fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Disk read failed\n");
+            return;
+        }
+        reads++;
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    bench_label(win, "disk");
+    fb_write_dec(win, per_read);
+    fb_write(win, per_read == 1 ? " sector/read: " : " sectors/read: ");
+    fb_write_dec(win, per_second(reads * per_read * dev->block_size, cycles) / 1024);
+    fb_write(win, " KB/s, ");
+    fb_write_dec(win, per_second(reads, cycles));
+    fb_write(win, " reads/s\n");
+}
+
+static int bench_disk(Window *win, const char *name) {
+    static const uint32_t per_read[] = { 1, 8, 64, 256, BENCH_DISK_MAX_READ };
+    BlockDevice *dev = *name ? block_find(name) : fat32_get_device();
+    if (!dev) {
+        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m No such disk\n");
+        return CONSOLE_EXECUTE_RUNTIME_ERROR;
+    }
+    uint8_t *buf = malloc(BENCH_DISK_MAX_READ * dev->block_size);
+    if (!buf) {
+        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Not enough memory for the disk buffer.\n");
+        return CONSOLE_EXECUTE_OOM;
+    }
+    bench_label(win, "disk");
+    fb_write(win, dev->name);
+    fb_write(win, ", ");
+    fb_write(win, dev->kind);
+    if (dev->model) {
+        fb_write(win, ", ");
+        fb_write(win, dev->model);
+    }
+    fb_write(win, ", ");
+    fb_write_dec(win, dev->blocks * dev->block_size / (1024 * 1024));
+    fb_write(win, " MB, ");
+    fb_write_dec(win, dev->max_request);
+    fb_write(win, " blocks per command\n");
+    for (size_t i = 0; i < sizeof(per_read) / sizeof(per_read[0]); i++)
+        bench_disk_run(win, dev, buf, per_read[i]);
+    free(buf);
+    return CONSOLE_EXECUTE_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Entry point
+// -----------------------------------------------------------------------------
+int console_bench(Window *win, const char *what) {
+    while (*what == ' ') what++;
+    if (!strcmp(what, "mem")) {
+        bench_memory(win);
+        return CONSOLE_EXECUTE_OK;
+    }
+    if (!strcmp(what, "heap")) {
+        bench_heap(win);
+        return CONSOLE_EXECUTE_OK;
+    }
+    if (!strcmp(what, "smp")) {
+        bench_smp(win);
+        return CONSOLE_EXECUTE_OK;
+    }
+    if (!strcmp(what, "disk"))
+        return bench_disk(win, "");
+    if (!strncmp(what, "disk ", 5))
+        return bench_disk(win, what + 5);
+    fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Unknown benchmark. Example: bench mem, bench heap, bench smp, bench disk\n");
+    return CONSOLE_EXECUTE_RUNTIME_ERROR;
+}
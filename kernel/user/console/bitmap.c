@@ -1,9 +1,10 @@
 #include "../console.h"
 #include "../../screen/screen.h"
 #include "../../file/fat32.h"
+#include "../../file/mmap.h"
 
 // -----------------------------------------------------------------------------
-// Fast BMP draw: reads the entire image into memory once
+// Fast BMP draw: maps the file, so pixels are read from the page cache in place
 // -----------------------------------------------------------------------------
 void fb_image_from_file(Window *win, int file_id, size_t target_width, size_t target_height) {
     if (file_id < 0) {
@@ -11,16 +12,26 @@ void fb_image_from_file(Window *win, int file_id, size_t target_width, size_t ta
         return;
     }
 
-    uint8_t header[54];
-    size_t read = fat32_read_chunk(file_id, header, 54, 0);
-    if (read < 54) {
+    size_t file_size = 0;
+    const uint8_t *file = mmap_file(file_id, &file_size);
+    if (!file || file_size < 54) {
         fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Failed to read BMP header.\n");
+        if (file)
+            mmap_release(file);
         return;
     }
+    const uint8_t *header = file;
 
     // --- Verify BMP signature ---
-    if (header[0] != 'B' || header[1] != 'M') {
+    int is_bmp = header[0] == 'B' && header[1] == 'M';
+    if (mmap_error(file)) {
+        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Failed to read BMP header.\n");
+        mmap_release(file);
+        return;
+    }
+    if (!is_bmp) {
         fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Unsupported image format.\n");
+        mmap_release(file);
         return;
     }
 
@@ -30,7 +41,10 @@ void fb_image_from_file(Window *win, int file_id, size_t target_width, size_t ta
     uint32_t height      = header[22] | (header[23] << 8) | (header[24] << 16) | (header[25] << 24);
     uint16_t bpp         = header[28] | (header[29] << 8);
 
-    if (width == 0 || height == 0) return;
+    if (width == 0 || height == 0) {
+        mmap_release(file);
+        return;
+    }
     if (!target_width)  target_width  = width;
     if (!target_height) target_height = height;
 
@@ -38,6 +52,7 @@ void fb_image_from_file(Window *win, int file_id, size_t target_width, size_t ta
         fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Unsupported BMP bit depth: ");
         fb_write_dec(win, bpp);
         fb_write(win, "\n");
+        mmap_release(file);
         return;
     }
 
@@ -45,20 +60,13 @@ void fb_image_from_file(Window *win, int file_id, size_t target_width, size_t ta
     uint32_t row_size = ((width * bytes_per_pixel + 3) & ~3); // 4-byte aligned
     size_t image_size = (size_t)row_size * height;
 
-    // --- Allocate full image buffer ---
-    uint8_t *img = malloc(image_size);
-    if (!img) {
-        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Not enough memory to load image.\n");
-        return;
-    }
-
-    // --- Read the entire image into RAM ---
-    size_t r = fat32_read_chunk(file_id, img, image_size, data_offset);
-    if (r < image_size) {
+    // --- Pixels stay in the mapping ---
+    if (data_offset > file_size || image_size > file_size - data_offset) {
         fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Incomplete BMP read (file too short).\n");
-        free(img);
+        mmap_release(file);
         return;
     }
+    const uint8_t *img = file + data_offset;
 
     // --- Render to framebuffer ---
     size_t x0 = win->cursor_x;
@@ -89,7 +97,9 @@ void fb_image_from_file(Window *win, int file_id, size_t target_width, size_t ta
         }
     }
 
-    free(img);
+    if (mmap_error(file))
+        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Incomplete BMP read (disk error).\n");
+    mmap_release(file);
     win->cursor_y += target_height;
 }
 
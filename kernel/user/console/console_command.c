@@ -1,5 +1,6 @@
 #include "../console.h"
 #include "elf.h"
+#include "../../file/mmap.h"
 
 extern uint32_t focus_id;
 
@@ -71,9 +72,15 @@ int console_command(Application *app) {
         fb_write_ansi(win, "\033[32mhelp\033[0m      - Show this help\n");
         fb_write_ansi(win, "\033[32mread\033[0m      - Read file or directory, up to 4KB\n");
         fb_write_ansi(win, "\033[32mfile X\033[0m    - Open file from path X\n");
+        fb_write_ansi(win, "\033[32mwrite\033[0m X Y - Replace file X with line Y, \033[32mappend\033[0m X Y adds it\n");
+        fb_write_ansi(win, "\033[32mrm\033[0m X      - Delete file X\n");
+        fb_write_ansi(win, "\033[32msync\033[0m      - Write cached changes to disk\n");
         fb_write_ansi(win, "\033[32mcd\033[0m X      - Change dir, can start from \033[33m/home\033[0m\n");
         //fb_write_ansi(win, "\033[32mcat\033[0m X     - Print file contents\n");
         fb_write_ansi(win, "\033[32mps\033[0m        - Show memory, disk, and resources\n");
+        fb_write_ansi(win, "\033[32mmem\033[0m       - Show allocator statistics, \033[32mmem trace on\033[0m adds callers\n");
+        fb_write_ansi(win, "\033[32mdisk\033[0m      - List block devices and cache, \033[32mdisk cache\033[0m X sets it to X KB\n");
+        fb_write_ansi(win, "\033[32mbench\033[0m X   - Run benchmark X (mem, heap, smp, disk)\n");
         fb_write_ansi(win, "\033[32mls\033[0m        - List files in current directory\n");
         fb_write_ansi(win, "\033[32mprint\033[0m X   - Print text X to the screen\n");
         fb_write_ansi(win, "\033[32mimg\033[0m X w h - Show image from file handle X\n");
@@ -130,12 +137,13 @@ int console_command(Application *app) {
             fb_write_ansi(win, "\x1b[32mOK\x1b[0m Focus to system console (no scroll)\n");
     }
     else if (!strcmp(cmd, "ps")) {
-        uint64_t memory_size = memory_total_with_regions();
-        uint64_t memory_cons = memory_used() + (memory_total_with_regions() - memory_total());
+        // Allocatable = heap managed so far + usable ranges not yet claimed by it
+        uint64_t memory_size = memory_total() + pmm_available();
+        uint64_t memory_cons = memory_used();
         struct FAT32_Usage usage = fat32_get_usage();
 
         fb_write_ansi(win, "\033[35mMemory\033[0m ");
-        fb_bar(win, (uint32_t)(memory_cons), (uint32_t)(memory_size), 50);
+        fb_bar(win, (long int)(memory_cons / 1024), (long int)(memory_size / 1024), 50);
         fb_write_dec(win, (memory_cons) / (1024 * 1024));
         fb_write(win, "MB / ");
         fb_write_dec(win, (memory_size) / (1024 * 1024));
@@ -192,6 +200,20 @@ int console_command(Application *app) {
         }
     }
 
+    else if (!strcmp(cmd, "mem") || !strncmp(cmd, "mem ", 4))
+        return console_mem(win, cmd + 3);
+    else if (!strcmp(cmd, "disk") || !strncmp(cmd, "disk ", 5))
+        return console_disk(win, cmd + 4);
+    else if (!strncmp(cmd, "write ", 6))
+        return console_write(win, cmd + 6, 0);
+    else if (!strncmp(cmd, "append ", 7))
+        return console_write(win, cmd + 7, 1);
+    else if (!strncmp(cmd, "rm ", 3))
+        return console_rm(win, cmd + 3);
+    else if (!strcmp(cmd, "sync"))
+        return console_sync(win);
+    else if (!strncmp(cmd, "bench ", 6))
+        return console_bench(win, cmd + 6);
     else if (!strncmp(cmd, "cd ", 3)) 
         fat32_cd(win, cmd + 3);
     // else if (!strncmp(cmd, "cat ", 4)) 
@@ -238,6 +260,10 @@ int console_command(Application *app) {
             fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Too many open files. Try to \x1b[32mkill\x1b[0m some.\n");
             return CONSOLE_EXECUTE_RUNTIME_ERROR;
         }
+        if (handle == -3) {
+            fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Not enough memory to open the file.\n");
+            return CONSOLE_EXECUTE_OOM;
+        }
         if (handle < 0) {
             fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Failed to open file: ");
             fb_write(win, path);
@@ -260,12 +286,12 @@ int console_command(Application *app) {
 
         // Convert handle number to string (manual itoa)
         int h = handle;
-        char digits[4]; // enough to store all digits
+        char digits[10]; // enough to store all digits
         int dpos = 0;
         if (h == 0) {
             digits[dpos++] = '0';
         } else {
-            while (h > 0 && dpos < 15) {
+            while (h > 0 && dpos < (int)sizeof(digits)) {
                 digits[dpos++] = '0' + (h % 10);
                 h /= 10;
             }
@@ -295,7 +321,7 @@ int console_command(Application *app) {
             arg++;
         }
 
-        if (file_id < 0 || file_id >= 16) {
+        if (file_id < 0) {
             fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Invalid file handle.\n");
             return CONSOLE_EXECUTE_RUNTIME_ERROR;
         }
@@ -375,14 +401,13 @@ int console_command(Application *app) {
 
         if (is_file) {
             // --- Kill a file handle ---
-            if (id >= 16) { // assuming max 16 file handles
+            if (id > 0x7FFFFFFF || fat32_close_user_file((int)id) < 0) {
                 fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Not open: file");
                 fb_write_dec(win, id);
                 fb_write(win, "\n");
                 return CONSOLE_EXECUTE_RUNTIME_ERROR;
             }
-            fat32_close_file(id);
-            fb_write_ansi(win, "\x1b[32mOK\x1b[0m Not open: ");
+            fb_write_ansi(win, "\x1b[32mOK\x1b[0m Closed: file");
             fb_write_dec(win, id);
             fb_write(win, "\n");
             return CONSOLE_EXECUTE_OK;
@@ -424,6 +449,10 @@ int console_command(Application *app) {
             }
             apps[id].window = NULL;
             apps[id].run = NULL;
+            if (&apps[id] == app)
+                app->killed = 1;  // its scratch buffers are in use until the command returns
+            else
+                arena_destroy(&apps[id].scratch);
             apps[id].save = NULL;
             apps[id].terminate = NULL;
             fb_write_ansi(win, "\x1b[32mOK\x1b[0m Killed: app");
@@ -594,28 +623,23 @@ int console_command(Application *app) {
 
         while (*end == ' ') end++;
         const char *args = *end ? end : "";
-        size_t file_size = fat32_get_file_size(program_path)+1;
-        if (!file_size) {
+        int handle = fat32_open_file(program_path);
+        if (handle < 0) {
             fb_write_ansi(win, "\x1b[31mERROR\x1b[0m File not found: ");
             fb_write(win, program_path);
             fb_write(win, "\n");
             return CONSOLE_EXECUTE_RUNTIME_ERROR;
         }
 
-        void* elf_data = malloc(file_size);
-        if(!elf_data) {
-            fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Not enough memory to load: ");
+        // Segments are copied out of the mapping, so the file itself is
+        // never read into a buffer of its own
+        size_t read_bytes = 0;
+        const void* elf_data = mmap_file(handle, &read_bytes);
+        fat32_close_file(handle);
+        if (!elf_data) {
+            fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Failed to map: ");
             fb_write(win, program_path);
             fb_write(win, "\n");
-            free(elf_data);
-            return CONSOLE_EXECUTE_RUNTIME_ERROR;
-        }
-        size_t read_bytes = fat32_read(elf_data, file_size, 0, program_path);
-        if (!read_bytes) {
-            fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Failed to read: ");
-            fb_write(win, program_path);
-            fb_write(win, "\n");
-            free(elf_data);
             return CONSOLE_EXECUTE_RUNTIME_ERROR;
         }
         fb_write_ansi(win, "\x1b[32mOK\x1b[0m Loaded ELF program (");
@@ -623,16 +647,23 @@ int console_command(Application *app) {
         fb_write_ansi(win, " bytes)\n");
         uint8_t* mod_base = NULL;
         typedef void (*entry_t)(void*, const char*);
-        entry_t main_entry = (entry_t)load_elf_module(win, elf_data, &mod_base);
+        entry_t main_entry = (entry_t)load_elf_module(win, (void*)elf_data, &mod_base);
+        if (mmap_error(elf_data)) {
+            fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Failed to read: ");
+            fb_write(win, program_path);
+            fb_write(win, "\n");
+            mmap_release(elf_data);
+            return CONSOLE_EXECUTE_RUNTIME_ERROR;
+        }
         if (!main_entry) {
             fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Missing or invalid main(void*, const char*).\n");
-            free(elf_data);
+            mmap_release(elf_data);
             return CONSOLE_EXECUTE_RUNTIME_ERROR;
         }
+        mmap_release(elf_data);
         //fb_write_ansi(win, "\x1b[32mOK\x1b[0m Running program...\n");
         main_entry(win, args);
         //fb_write_ansi(win, "\n\x1b[32mOK\x1b[0m Program exited.\n");
-        free(elf_data);
     }
 
 
@@ -0,0 +1,140 @@
+#include "../console.h"
+#include "../../file/block.h"
+#include "../../file/ramdisk.h"
+#include "../../file/bcache.h"
+#include "../../file/dentry.h"
+#include "../../file/mmap.h"
+
+// -----------------------------------------------------------------------------
+// disk: registered block devices, the buffer cache, and RAM disks on demand
+// -----------------------------------------------------------------------------
+// 0 and the value in *out, or -1 unless `p` is digits (trailing spaces allowed)
+static int disk_parse_number(const char *p, uint64_t *out) {
+    uint64_t value = 0;
+    const char *start = p;
+    for (; *p >= '0' && *p <= '9'; p++)
+        value = value * 10 + (*p - '0');
+    if (p == start)
+        return -1;
+    while (*p == ' ')
+        p++;
+    if (*p)
+        return -1;
+    *out = value;
+    return 0;
+}
+
+static void disk_cache_describe(Window *win) {
+    BCacheStats stats;
+    bcache_get_stats(&stats);
+    uint64_t lookups = stats.hits + stats.misses;
+    fb_write_ansi(win, "\033[35mcache\033[0m ");
+    fb_write_dec(win, stats.bytes / 1024);
+    fb_write(win, " KB of ");
+    fb_write_dec(win, stats.limit / 1024);
+    fb_write(win, " KB, ");
+    fb_write_dec(win, stats.hits);
+    fb_write(win, " hits, ");
+    fb_write_dec(win, stats.misses);
+    fb_write(win, " misses (");
+    fb_write_dec(win, lookups ? stats.hits * 100 / lookups : 0);
+    fb_write(win, "% hit), ");
+    fb_write_dec(win, stats.evictions);
+    fb_write(win, " evictions\n    ");
+    fb_write_dec(win, stats.dirty);
+    fb_write(win, " dirty blocks, ");
+    fb_write_dec(win, stats.writebacks);
+    fb_write(win, " written back in ");
+    fb_write_dec(win, stats.flushes);
+    fb_write(win, " requests\n");
+
+    DentryStats dentries;
+    dentry_get_stats(&dentries);
+    fb_write_ansi(win, "\033[35mnames\033[0m ");
+    fb_write_dec(win, dentries.hits);
+    fb_write(win, " hits, ");
+    fb_write_dec(win, dentries.negative_hits);
+    fb_write(win, " negative hits, ");
+    fb_write_dec(win, dentries.misses);
+    fb_write(win, " misses\n");
+
+    MmapStats pages;
+    mmap_get_stats(&pages);
+    fb_write_ansi(win, "\033[35mpages\033[0m ");
+    fb_write_dec(win, pages.pages);
+    fb_write(win, " of ");
+    fb_write_dec(win, MMAP_CACHE_PAGES);
+    fb_write(win, " cached, ");
+    fb_write_dec(win, pages.mappings);
+    fb_write(win, " mappings, ");
+    fb_write_dec(win, pages.hits);
+    fb_write(win, " hits, ");
+    fb_write_dec(win, pages.misses);
+    fb_write(win, " read, ");
+    fb_write_dec(win, pages.evictions);
+    fb_write(win, " evictions\n");
+}
+static void disk_describe(Window *win, BlockDevice *dev) {
+    fb_write_ansi(win, "\033[35m");
+    fb_write(win, dev->name);
+    fb_write_ansi(win, "\033[0m ");
+    fb_write_dec(win, dev->blocks * dev->block_size / (1024 * 1024));
+    fb_write(win, " MB, ");
+    fb_write(win, dev->kind);
+    if (dev->model) {
+        fb_write(win, ", ");
+        fb_write(win, dev->model);
+    }
+    if (!dev->ops->write)
+        fb_write(win, ", read only");
+    if (dev == fat32_get_device())
+        fb_write(win, ", mounted");
+    fb_write(win, "\n    ");
+    fb_write_dec(win, dev->reads);
+    fb_write(win, " reads (");
+    fb_write_dec(win, dev->blocks_read);
+    fb_write(win, " blocks), ");
+    fb_write_dec(win, dev->writes);
+    fb_write(win, " writes (");
+    fb_write_dec(win, dev->blocks_written);
+    fb_write(win, " blocks)\n");
+}
+
+int console_disk(Window *win, const char *args) {
+    while (*args == ' ') args++;
+    if (!strcmp(args, "cache") || !strncmp(args, "cache ", 6)) {
+        uint64_t kb;
+        if (args[5] && disk_parse_number(args + 6, &kb) < 0) {
+            fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Expected a size in KB. Example: disk cache 512\n");
+            return CONSOLE_EXECUTE_RUNTIME_ERROR;
+        }
+        if (args[5] && bcache_set_limit(kb * 1024) < 0) {
+            fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Cannot turn the cache off: some changes could not be written back\n");
+            return CONSOLE_EXECUTE_RUNTIME_ERROR;
+        }
+        disk_cache_describe(win);
+        return CONSOLE_EXECUTE_OK;
+    }
+    if (!strncmp(args, "ram ", 4)) {
+        uint64_t mb = 0;
+        BlockDevice *dev = !disk_parse_number(args + 4, &mb) && mb ? ramdisk_create(mb * 2048) : NULL;
+        if (!dev) {
+            fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Cannot create a RAM disk of that size\n");
+            return CONSOLE_EXECUTE_OOM;
+        }
+        fb_write_ansi(win, "\x1b[32mOK\x1b[0m Created ");
+        fb_write(win, dev->name);
+        fb_write(win, "\n");
+        return CONSOLE_EXECUTE_OK;
+    }
+    if (*args) {
+        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Valid usage: disk | disk cache <KB> | disk ram <MB>\n");
+        return CONSOLE_EXECUTE_RUNTIME_ERROR;
+    }
+    if (!block_count())
+        fb_write(win, "No block devices\n");
+    for (int i = 0; i < block_count(); i++)
+        disk_describe(win, block_get(i));
+    disk_cache_describe(win);
+    return CONSOLE_EXECUTE_OK;
+}
@@ -1,6 +1,7 @@
 #include "../console.h"
 
 #define TMP_SIZE APPLICATION_MESSAGE_SIZE
+#define SCRATCH_SIZE (3 * TMP_SIZE)  // buffer, inner and output
 
 static int isspace_local(unsigned char c) {
     return c==' ' || c=='\t'|| c=='\n' || c=='\r' || c=='\v' || c=='\f';
@@ -84,20 +85,19 @@ int console_execute(Application *app) {
         }
     }
 
-    char *buffer = malloc(TMP_SIZE);
-    if(!buffer)
+    // Scratch buffers come from the app's arena and are all taken before
+    // evaluating anything, so a nested expression cannot run out halfway
+    Arena *scratch = &app->scratch;
+    if(!scratch->base && arena_init(scratch, SCRATCH_SIZE))
         return CONSOLE_EXECUTE_OOM;
-    char *inner = malloc(TMP_SIZE);
-    if(!inner) {
-        free(buffer);
+    size_t mark = arena_mark(scratch);
+    char *buffer = arena_alloc(scratch, TMP_SIZE);
+    char *inner = arena_alloc(scratch, TMP_SIZE);
+    char *output = arena_alloc(scratch, TMP_SIZE);
+    if(!buffer || !inner || !output) {
+        arena_release(scratch, mark);
         return CONSOLE_EXECUTE_OOM;
     }
-    char *output = malloc(TMP_SIZE);
-    if(!output) {
-        free(buffer);
-        free(inner);
-        return CONSOLE_EXECUTE_RUNTIME_ERROR;
-    }
 
     char *saved_data = app->data;
     char *saved_output = app->output;
@@ -165,9 +165,11 @@ int console_execute(Application *app) {
             app->output = saved_output;
             app->output[0] = 0;
             app->output_state = 0;
-            free(buffer);
-            free(output);
-            free(inner);
+            arena_release(scratch, mark);
+            if (app->killed) {
+                arena_destroy(scratch);
+                app->killed = 0;
+            }
             return ret;
         }
 
@@ -202,15 +204,17 @@ int console_execute(Application *app) {
 
     strncpy((char*)app->data, buffer, len+1); // include the null termination
 
-    // cleanup and run final command 
-    free(inner);
-    free(output);
+    // run final command 
     app->data = buffer;
     app->output = saved_output;
     app->output[0] = 0;
     app->output_state = 0;
     int ret = console_command(app);
     app->data = saved_data;
-    free(buffer);
+    arena_release(scratch, mark);
+    if (app->killed) {
+        arena_destroy(scratch);
+        app->killed = 0;
+    }
     return ret;
 }
@@ -0,0 +1,116 @@
+#include "../console.h"
+
+// -----------------------------------------------------------------------------
+// mem: allocator statistics and, when tracing, live memory per call site
+// -----------------------------------------------------------------------------
+#define MEM_TOP_CALLERS 8
+
+static void mem_label(Window *win, const char *name) {
+    fb_write_ansi(win, "\033[35m");
+    fb_write(win, name);
+    fb_write_ansi(win, "\033[0m ");
+}
+
+static void mem_write_size(Window *win, uint64_t bytes) {
+    if (bytes >= 16 * 1024 * 1024) {
+        fb_write_dec(win, bytes / (1024 * 1024));
+        fb_write(win, "MB");
+    } else if (bytes >= 1024) {
+        fb_write_dec(win, bytes / 1024);
+        fb_write(win, "KB");
+    } else {
+        fb_write_dec(win, bytes);
+        fb_write(win, "B");
+    }
+}
+
+static void mem_summary(Window *win, const MemoryStats *stats) {
+    mem_label(win, "heap");
+    mem_write_size(win, memory_used());
+    fb_write(win, " used, ");
+    mem_write_size(win, stats->peak_used);
+    fb_write(win, " peak, ");
+    mem_write_size(win, paging_heap_committed());
+    fb_write(win, " committed of ");
+    mem_write_size(win, memory_total());
+    fb_write(win, " reserved, ");
+    mem_write_size(win, pmm_available());
+    fb_write(win, " free\n");
+    if (stats->failed) {
+        fb_write_ansi(win, "\033[31m");
+        fb_write_dec(win, stats->failed);
+        fb_write_ansi(win, " failed allocations\033[0m\n");
+    }
+}
+
+static void mem_orders(Window *win, const MemoryStats *stats) {
+    for (int i = 0; i < ORDER_COUNT; i++) {
+        if (!stats->allocs[i])
+            continue;
+        mem_label(win, "block");
+        mem_write_size(win, 1ULL << (i + MIN_ORDER));
+        fb_write(win, ": ");
+        fb_write_dec(win, stats->live[i]);
+        fb_write(win, " live, ");
+        fb_write_dec(win, stats->allocs[i]);
+        fb_write(win, " total\n");
+    }
+    for (int c = 0; c < SLAB_CLASS_COUNT; c++) {
+        if (!stats->slab_live[c] && !stats->slab_cached[c])
+            continue;
+        mem_label(win, "slab");
+        fb_write_dec(win, slab_class_bytes(c));
+        fb_write(win, "B: ");
+        fb_write_dec(win, stats->slab_live[c]);
+        fb_write(win, " live, ");
+        fb_write_dec(win, stats->slab_cached[c]);
+        fb_write(win, " cached\n");
+    }
+}
+
+static void mem_callers(Window *win) {
+    MemoryCaller callers[MEM_TOP_CALLERS];
+    size_t count = memory_trace_callers(callers, MEM_TOP_CALLERS);
+    for (size_t i = 0; i < count; i++) {
+        mem_label(win, "caller");
+        fb_write_hex(win, (uint64_t)callers[i].caller);
+        fb_write(win, ": ");
+        fb_write_dec(win, callers[i].blocks);
+        fb_write(win, " blocks, ");
+        mem_write_size(win, callers[i].bytes);
+        fb_write(win, "\n");
+    }
+    uint64_t dropped = memory_trace_dropped();
+    if (dropped) {
+        fb_write_dec(win, dropped);
+        fb_write(win, " allocations not traced (table full)\n");
+    }
+}
+
+int console_mem(Window *win, const char *args) {
+    static int tracing = 0;
+    while (*args == ' ') args++;
+    if (!strcmp(args, "trace on") || !strcmp(args, "trace off")) {
+        int enable = !strcmp(args, "trace on");
+        if (!memory_trace(enable)) {
+            fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Caller tracing is compiled out (MEMORY_TRACE_CALLERS)\n");
+            return CONSOLE_EXECUTE_RUNTIME_ERROR;
+        }
+        tracing = enable;
+        fb_write_ansi(win, enable ? "\x1b[32mOK\x1b[0m Tracing new allocations\n"
+                                  : "\x1b[32mOK\x1b[0m Tracing stopped\n");
+        return CONSOLE_EXECUTE_OK;
+    }
+    if (*args) {
+        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Valid usage: mem | mem trace on | mem trace off\n");
+        return CONSOLE_EXECUTE_RUNTIME_ERROR;
+    }
+
+    MemoryStats stats;
+    memory_get_stats(&stats);
+    mem_summary(win, &stats);
+    mem_orders(win, &stats);
+    if (tracing)
+        mem_callers(win);
+    return CONSOLE_EXECUTE_OK;
+}
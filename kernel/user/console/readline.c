@@ -15,7 +15,8 @@ int shift = 0, ctrl = 0;
 static const char* keywords[] = {
     "help","ls","cd","ps","clear",
     "app","kill","to","log","exit","let","read","print",
-    "image","file","args","go", "run"
+    "image","file","args","go", "run", "bench", "mem", "disk",
+    "write", "append", "rm", "sync"
 };
 #define NUM_KEYWORDS (sizeof(keywords)/sizeof(keywords[0]))
 
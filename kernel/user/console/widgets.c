@@ -2,6 +2,7 @@
 
 void poweroff(Window *win) {
     fb_write_ansi(win, "\x1b[32mShutting down...\x1b[0m\n");
+    fat32_sync();
     outw(0x604, 0x2000);
     outw(0xB004, 0x2000);
     for (;;) __asm__("hlt");
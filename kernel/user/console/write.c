@@ -0,0 +1,79 @@
+#include "../console.h"
+
+// -----------------------------------------------------------------------------
+// write, append, rm, sync: changes to the mounted volume. They reach the disk
+// on sync, on exit, or when the buffer cache needs the room.
+// -----------------------------------------------------------------------------
+static int write_report(Window *win, int result, const char *done, const char *path) {
+    if (result == -2) {
+        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Disk full: ");
+        fb_write(win, path);
+        fb_write(win, "\n");
+        return CONSOLE_EXECUTE_RUNTIME_ERROR;
+    }
+    if (result < 0) {
+        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Cannot write: ");
+        fb_write(win, path);
+        fb_write(win, "\n");
+        return CONSOLE_EXECUTE_RUNTIME_ERROR;
+    }
+    fb_write_ansi(win, "\x1b[32mOK\x1b[0m ");
+    fb_write(win, done);
+    fb_write(win, path);
+    fb_write(win, "\n");
+    return CONSOLE_EXECUTE_OK;
+}
+
+// "write path text" replaces the file with the text as one line, "append"
+// adds the line at its end; both create the file if it is missing
+int console_write(Window *win, const char *args, int append) {
+    char path[256];
+    int n = 0;
+    while (*args == ' ') args++;
+    while (*args && *args != ' ' && n < (int)sizeof(path) - 1)
+        path[n++] = *args++;
+    path[n] = 0;
+    while (*args == ' ') args++;
+    if (!n) {
+        fb_write_ansi(win, append ? "\x1b[31mERROR\x1b[0m Missing path. Example: append notes.txt some text\n"
+                                  : "\x1b[31mERROR\x1b[0m Missing path. Example: write notes.txt some text\n");
+        return CONSOLE_EXECUTE_RUNTIME_ERROR;
+    }
+
+    size_t len = strlen(args);
+    char *line = malloc(len + 1);
+    if (!line) {
+        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Out of memory\n");
+        return CONSOLE_EXECUTE_OOM;
+    }
+    memcpy(line, args, len);
+    line[len] = '\n';
+
+    // Overwrite first and cut the tail after, so a failed write leaves the
+    // old contents in place. A missing file is created and written once more.
+    int result = append ? fat32_append(path, line, len + 1) : fat32_write(path, line, len + 1, 0);
+    if (result == -1 && (result = fat32_create(path)) == 0)
+        result = append ? fat32_append(path, line, len + 1) : fat32_write(path, line, len + 1, 0);
+    if (!result && !append)
+        result = fat32_truncate(path, len + 1);
+    free(line);
+    return write_report(win, result, append ? "Appended to " : "Wrote ", path);
+}
+
+int console_rm(Window *win, const char *path) {
+    while (*path == ' ') path++;
+    if (!*path) {
+        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Missing path. Example: rm notes.txt\n");
+        return CONSOLE_EXECUTE_RUNTIME_ERROR;
+    }
+    return write_report(win, fat32_delete(path), "Deleted ", path);
+}
+
+int console_sync(Window *win) {
+    if (fat32_sync() != 0) {
+        fb_write_ansi(win, "\x1b[31mERROR\x1b[0m Could not write everything back to disk\n");
+        return CONSOLE_EXECUTE_RUNTIME_ERROR;
+    }
+    fb_write_ansi(win, "\x1b[32mOK\x1b[0m Disk up to date\n");
+    return CONSOLE_EXECUTE_OK;
+}